@@ -0,0 +1,641 @@
+#include <SFML/Graphics.hpp>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#define HAVE_SFML
+#include "utils/random.h"
+#include "headers/solver.h"
+#include "headers/render_frame.h"
+#include "headers/step_graph.h"
+#include "headers/triple_buffer.h"
+
+// Micro and macro benchmarks for the integrators and collision solvers.
+// Results are printed as JSON unless another --benchmark_format is given:
+//
+//   bench --benchmark_out=results.json
+
+constexpr unsigned int SEED = 1234;
+constexpr size_t UPDATE_BATCH = 1024;
+
+// Radius range that keeps about half of the window covered whatever the ball count
+static float maxRadiusFor(size_t count)
+{
+    const float packed = std::sqrt(0.5f * width * height / (count * PI_f));
+    return std::min(25.f, 1.5f * packed);
+}
+
+template <typename Balls>
+static void fillRandom(Balls& balls, size_t count)
+{
+    utils::Random randomizer(SEED);
+    const float max_radius = maxRadiusFor(count);
+    const float min_radius = std::min(2.f, max_radius);
+    for (size_t i{0}; i < count; ++i) {
+        const float radius = randomizer.generateRandomFloat(min_radius, max_radius);
+        const float x      = randomizer.generateRandomFloat(max_radius, width - max_radius);
+        const float y      = randomizer.generateRandomFloat(max_radius, height - max_radius);
+        const float speed  = randomizer.generateRandomFloat(0.f, 5.f);
+        const float angle  = randomizer.generateRandomFloat(0.f, 2.f * PI_f);
+        balls.emplace_back(radius, Vec2{x, y}, speed, angle);
+    }
+}
+
+// Integrators, one ball object at a time
+template <typename T>
+static void BM_UpdatePosition(benchmark::State& state)
+{
+    std::vector<T> balls;
+    balls.reserve(UPDATE_BATCH);
+    fillRandom(balls, UPDATE_BATCH);
+    for (auto _ : state) {
+        for (auto& ball : balls) ball.updatePosition();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * UPDATE_BATCH);
+}
+BENCHMARK_TEMPLATE(BM_UpdatePosition, VerletBall);
+BENCHMARK_TEMPLATE(BM_UpdatePosition, EulerBall);
+BENCHMARK_TEMPLATE(BM_UpdatePosition, ImplicitEulerBall);
+BENCHMARK_TEMPLATE(BM_UpdatePosition, RK4Ball);
+BENCHMARK_TEMPLATE(BM_UpdatePosition, RK45Ball);
+
+// Integrators over a ParticleStore
+template <typename T>
+static void BM_UpdatePositions(benchmark::State& state)
+{
+    ParticleStore<T> balls;
+    fillRandom(balls, UPDATE_BATCH);
+    for (auto _ : state) {
+        balls.updatePositions();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * UPDATE_BATCH);
+}
+BENCHMARK_TEMPLATE(BM_UpdatePositions, VerletBall);
+BENCHMARK_TEMPLATE(BM_UpdatePositions, EulerBall);
+BENCHMARK_TEMPLATE(BM_UpdatePositions, ImplicitEulerBall);
+BENCHMARK_TEMPLATE(BM_UpdatePositions, RK4Ball);
+BENCHMARK_TEMPLATE(BM_UpdatePositions, RK45Ball);
+
+// Eccentric orbit around a point mass, 4 s at 30 Hz. The close pass needs small steps,
+// the far side does not. Reports field evaluations per physics step and the relative
+// energy drift, fixed step RK4 with range(0) substeps against RK45 with tolerance 10^-range(0).
+const Scalar ORBIT_MASS    = 4e7f;
+const Scalar ORBIT_DT      = 1.f / 30.f;
+constexpr int ORBIT_STEPS  = 120;
+const Vec2 ORBIT_CENTER{500.f, 500.f};
+
+static Vec2 pointMass(Vec2 position, Vec2)
+{
+    const Vec2 offset = position - ORBIT_CENTER;
+    const Scalar r = utils::norm2f(offset);
+    return offset * (-ORBIT_MASS / (r * r * r));
+}
+
+static State orbitStart()
+{
+    return {ORBIT_CENTER + Vec2{300.f, 0.f}, {0.f, Scalar(0.3f) * utils::sqrt(ORBIT_MASS / Scalar(300))}};
+}
+
+static double orbitEnergy(const State& state)
+{
+    return 0.5 * static_cast<double>(utils::dot(state.velocity, state.velocity))
+         - static_cast<double>(ORBIT_MASS / utils::norm2f(state.position - ORBIT_CENTER));
+}
+
+static void BM_OrbitRK4(benchmark::State& bench)
+{
+    const int substeps = static_cast<int>(bench.range(0));
+    const Scalar h = ORBIT_DT / Scalar(substeps);
+    auto derivative = [](const State& s) { return Derivative{s.velocity, pointMass(s.position, s.velocity)}; };
+    auto stage = [](const State& s, const Derivative& d, Scalar t) {
+        return State{s.position + d.dPosition * t, s.velocity + d.dVelocity * t};
+    };
+    State state;
+    for (auto _ : bench) {
+        state = orbitStart();
+        for (int i{0}; i < ORBIT_STEPS * substeps; ++i) {
+            const Derivative a = derivative(state);
+            const Derivative b = derivative(stage(state, a, Scalar(0.5f) * h));
+            const Derivative c = derivative(stage(state, b, Scalar(0.5f) * h));
+            const Derivative d = derivative(stage(state, c, h));
+            state.position += (a.dPosition + Scalar(2) * (b.dPosition + c.dPosition) + d.dPosition) * (h / Scalar(6));
+            state.velocity += (a.dVelocity + Scalar(2) * (b.dVelocity + c.dVelocity) + d.dVelocity) * (h / Scalar(6));
+        }
+        benchmark::DoNotOptimize(state);
+    }
+    const double exact = orbitEnergy(orbitStart());
+    bench.counters["evals/step"] = 4. * substeps;
+    bench.counters["energy_err"] = std::fabs((orbitEnergy(state) - exact) / exact);
+}
+BENCHMARK(BM_OrbitRK4)->ArgName("substeps")->RangeMultiplier(4)->Range(1, 64);
+
+static void BM_OrbitRK45(benchmark::State& bench)
+{
+    const dormand_prince::Settings saved = dormand_prince::settings;
+    dormand_prince::settings.field     = pointMass;
+    dormand_prince::settings.tolerance = std::pow(10.f, -static_cast<float>(bench.range(0)));
+    State state;
+    uint64_t evaluations = 0;
+    for (auto _ : bench) {
+        state = orbitStart();
+        Scalar step = ORBIT_DT;
+        const uint64_t before = dormand_prince::evaluations;
+        for (int i{0}; i < ORBIT_STEPS; ++i) dormand_prince::advance(state, ORBIT_DT, step);
+        evaluations = dormand_prince::evaluations - before;
+        benchmark::DoNotOptimize(state);
+    }
+    dormand_prince::settings = saved;
+    const double exact = orbitEnergy(orbitStart());
+    bench.counters["evals/step"] = static_cast<double>(evaluations) / ORBIT_STEPS;
+    bench.counters["energy_err"] = std::fabs((orbitEnergy(state) - exact) / exact);
+}
+BENCHMARK(BM_OrbitRK45)->ArgName("-log10_tol")->DenseRange(0, 4);
+
+// Mutual gravity on range(0) balls through the Barnes–Hut tree (accumulate builds it and
+// evaluates every ball), against the direct pairwise sum it replaces
+static void BM_Gravitation(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    ParticleStore<VerletBall> balls;
+    fillRandom(balls, count);
+    Gravitation gravitation;
+    gravitation.enabled = true;
+    Forces::setGravitation(gravitation);
+    for (auto _ : state) {
+        Forces::accumulate(balls);
+        benchmark::ClobberMemory();
+    }
+    Forces::reset();
+    state.counters["tree_nodes"] = static_cast<double>(Forces::getTreeNodeCount());
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Gravitation)->ArgName("balls")->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+
+static void BM_GravitationPairwise(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    ParticleStore<VerletBall> balls;
+    fillRandom(balls, count);
+    std::vector<Scalar> ax(count), ay(count);
+    const Scalar soft2 = Gravitation{}.softening * Gravitation{}.softening;
+    for (auto _ : state) {
+        for (size_t i{0}; i < count; ++i) {
+            Scalar sum_x = 0.f, sum_y = 0.f;
+            for (size_t j{0}; j < count; ++j) {
+                const Scalar dx = balls.x[j] - balls.x[i], dy = balls.y[j] - balls.y[i];
+                const Scalar d2 = dx * dx + dy * dy + soft2;
+                const Scalar strength = balls.radius[j] * balls.radius[j] / (d2 * utils::sqrt(d2));
+                sum_x += strength * dx;
+                sum_y += strength * dy;
+            }
+            ax[i] = sum_x;
+            ay[i] = sum_y;
+        }
+        benchmark::DoNotOptimize(ax.data());
+        benchmark::DoNotOptimize(ay.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GravitationPairwise)->ArgName("balls")->RangeMultiplier(10)->Range(1000, 10000)->Unit(benchmark::kMillisecond);
+
+// Erase the oldest ball and spawn a new one in a store of range(0) balls, the emitter steady state
+static void BM_SpawnDespawn(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    ParticleStore<VerletBall> balls;
+    balls.reserve(count);
+    std::vector<ParticleHandle> handles;
+    handles.reserve(count);
+    for (size_t i{0}; i < count; ++i) handles.push_back(balls.emplace_back(5.f, {500.f, 500.f}, 1.f, 0.f));
+
+    size_t oldest = 0;
+    for (auto _ : state) {
+        balls.erase(handles[oldest]);
+        handles[oldest] = balls.emplace_back(5.f, {500.f, 500.f}, 1.f, 0.f);
+        oldest = (oldest + 1) % count;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpawnDespawn)->ArgName("balls")->Arg(1000)->Arg(100000);
+
+// Copy the state of range(0) balls into a triple buffer slot and publish it, what the simulation
+// thread of the demo adds to every batch of steps
+static void BM_PublishFrame(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    ParticleStore<VerletBall> balls;
+    fillRandom(balls, count);
+    TripleBuffer<RenderFrame> frames;
+    const std::vector<Wall> walls{Wall({500.f, 350.f}, 300.f, 5.f, -45.f), Wall({275.f, 400.f}, 300.f, 5.f, 30.f)};
+
+    uint64_t step = 0;
+    for (auto _ : state) {
+        frames.write().capture(balls, walls, ++step, 1.f / 120.f);
+        frames.publish();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_PublishFrame)->ArgName("balls")->Arg(1000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// One substep of range(0) balls through the StepGraph (forces to packing a frame) on range(1)
+// threads with range(2) balls per task, threads 0 runs the same phases in line instead. The
+// counters are what JobSystem reports to tune the chunk sizes with. Real time, the calling
+// thread is only one of the threads doing the work.
+static void BM_StepGraph(benchmark::State& state)
+{
+    const size_t count   = static_cast<size_t>(state.range(0));
+    const size_t threads = static_cast<size_t>(state.range(1));
+    std::vector<Wall> walls{Wall({500.f, 350.f}, 300.f, 5.f, -45.f), Wall({275.f, 400.f}, 300.f, 5.f, 30.f)};
+    ParticleStore<VerletBall> balls;
+    fillRandom(balls, count);
+    RenderFrame frame;
+
+    Solver::setBroadPhase(BroadPhase::Grid);
+    JobSystem jobs(std::max<size_t>(threads, 1));
+    StepGraph<VerletBall, std::vector<Wall>> graph(balls, walls);
+    graph.setBallsPerTask(static_cast<size_t>(state.range(2)));
+    for (auto _ : state) {
+        if (threads > 0) {
+            graph.step(jobs, &frame);
+        } else {
+            Forces::accumulate(balls);
+            balls.updatePositions();
+            Solver::resolveCollisions<VerletBall>(balls, walls);
+            frame.resize(balls.size());
+            frame.pack(balls, 0, balls.size());
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    if (threads == 0) return;
+    uint64_t steals = 0;
+    double busy = 0.0;
+    for (size_t i{0}; i < jobs.size(); ++i) {
+        steals += jobs.getWorkerStats(i).steals;
+        busy   += jobs.getUtilization(i);
+    }
+    state.counters["utilization"] = busy / jobs.size();
+    state.counters["steals/step"] = static_cast<double>(steals) / jobs.getRunCount();
+}
+
+static void stepGraphArguments(benchmark::internal::Benchmark* bench)
+{
+    bench->Args({100000, 0, 1024});
+    for (int64_t threads : {1, 2, 4}) {
+        for (int64_t chunk : {256, 1024, 4096}) bench->Args({100000, threads, chunk});
+    }
+    bench->ArgNames({"balls", "threads", "chunk"})->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+BENCHMARK(BM_StepGraph)->Apply(stepGraphArguments);
+
+// Verlet store integration at 100k particles with each SIMD kernel, range(0) is simd::Isa
+static void BM_VerletKernel(benchmark::State& state)
+{
+    const auto isa = static_cast<simd::Isa>(state.range(0));
+    if (!simd::setIsa(isa)) {
+        state.SkipWithError("instruction set not supported by this CPU");
+        return;
+    }
+
+    const size_t count = 100000;
+    ParticleStore<VerletBall> balls;
+    balls.reserve(count);
+    fillRandom(balls, count);
+    for (auto _ : state) {
+        balls.updatePositions();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetLabel(simd::toString(isa));
+    simd::setIsa(simd::bestIsa());
+}
+BENCHMARK(BM_VerletKernel)->ArgName("isa")->DenseRange(0, 2);
+
+// Narrowphase on a pair of overlapping balls, restored every iteration
+template <typename T>
+static void BM_ResolvePairCollision(benchmark::State& state)
+{
+    const T ballA(10.f, {500.f, 500.f}, 1.f, 0.f);
+    const T ballB(10.f, {515.f, 505.f}, 1.f, PI_f);
+    for (auto _ : state) {
+        T a = ballA;
+        T b = ballB;
+        CollisionSolver<T>::resolvePairCollision(a, b);
+        Vec2 posA = a.getPosition(), posB = b.getPosition();
+        benchmark::DoNotOptimize(posA);
+        benchmark::DoNotOptimize(posB);
+    }
+}
+BENCHMARK_TEMPLATE(BM_ResolvePairCollision, VerletBall);
+BENCHMARK_TEMPLATE(BM_ResolvePairCollision, EulerBall);
+BENCHMARK_TEMPLATE(BM_ResolvePairCollision, RK4Ball);
+
+template <typename T>
+static void BM_ResolveWallCollision(benchmark::State& state)
+{
+    Wall wall({500.f, 350.f}, 300.f, 5.f, -45.f);
+    const T ball(10.f, {600.f, 250.f}, 1.f, 0.f);
+    for (auto _ : state) {
+        T b = ball;
+        CollisionSolver<T>::resolveWallCollision(b, wall);
+        Vec2 position = b.getPosition();
+        benchmark::DoNotOptimize(position);
+    }
+}
+BENCHMARK_TEMPLATE(BM_ResolveWallCollision, VerletBall);
+BENCHMARK_TEMPLATE(BM_ResolveWallCollision, EulerBall);
+BENCHMARK_TEMPLATE(BM_ResolveWallCollision, RK4Ball);
+
+static void BM_ClosestPointToWall(benchmark::State& state)
+{
+    Wall wall({500.f, 350.f}, 300.f, 5.f, -45.f);
+    Vec2 position{600.f, 250.f};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(position);
+        Vec2 closest = closestPointToWall(position, wall);
+        benchmark::DoNotOptimize(closest);
+    }
+}
+BENCHMARK(BM_ClosestPointToWall);
+
+// Short random segments all over the window, a stand-in for a large level layout
+static std::vector<Wall> randomWalls(size_t count)
+{
+    utils::Random randomizer(SEED + 1);
+    std::vector<Wall> walls;
+    walls.reserve(count);
+    for (size_t i{0}; i < count; ++i) {
+        const float x = randomizer.generateRandomFloat(0.f, static_cast<float>(width));
+        const float y = randomizer.generateRandomFloat(0.f, static_cast<float>(height));
+        walls.emplace_back(Vec2{x, y}, randomizer.generateRandomFloat(10.f, 40.f), 2.f,
+                           randomizer.generateRandomFloat(0.f, 360.f));
+    }
+    return walls;
+}
+
+// Wall collisions of 10k balls, range(0) walls, range(1) 0 = every wall per ball, 1 = WallTree
+template <typename T>
+static void BM_WallCollisions(benchmark::State& state)
+{
+    const size_t wall_count = static_cast<size_t>(state.range(0));
+    const bool use_tree     = state.range(1) != 0;
+    const std::vector<Wall> walls = randomWalls(wall_count);
+    const WallTree tree(walls);
+
+    ParticleStore<T> initial;
+    fillRandom(initial, 10000);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<T> balls = initial;
+        state.ResumeTiming();
+
+        for (size_t i{0}; i < balls.size(); ++i) {
+            if (use_tree) {
+                tree.query(balls.getPosition(i), balls.radius[i],
+                           [&](const Wall& wall) { CollisionSolver<T>::resolveWallCollision(balls, i, wall); });
+            } else {
+                for (const auto& wall : walls) CollisionSolver<T>::resolveWallCollision(balls, i, wall);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * initial.size());
+    state.SetLabel(use_tree ? "tree" : "list");
+}
+BENCHMARK_TEMPLATE(BM_WallCollisions, VerletBall)
+    ->ArgsProduct({{10, 100, 1000, 10000}, {0, 1}})->ArgNames({"walls", "tree"})->Unit(benchmark::kMicrosecond);
+
+// Full Solver::resolveCollisions on a random scene, range(0) balls, range(1) broadphase
+template <typename T>
+static void BM_ResolveCollisions(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const auto mode    = static_cast<BroadPhase>(state.range(1));
+    std::vector<Wall> walls{Wall({500.f, 350.f}, 300.f, 5.f, -45.f), Wall({275.f, 400.f}, 300.f, 5.f, 30.f)};
+
+    ParticleStore<T> initial;
+    initial.reserve(count);
+    fillRandom(initial, count);
+
+    Solver::setBroadPhase(mode);
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<T> balls = initial;
+        state.ResumeTiming();
+
+        Solver::resolveCollisions<T>(balls, walls);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetLabel(toString(mode));
+    state.counters["pairs_tested"]    = static_cast<double>(Solver::getPairStats().tested);
+    state.counters["pairs_colliding"] = static_cast<double>(Solver::getPairStats().colliding);
+}
+
+static void solverArguments(benchmark::internal::Benchmark* bench)
+{
+    for (int64_t count : {100, 1000, 10000, 100000}) {
+        for (auto mode : {BroadPhase::BruteForce, BroadPhase::Grid, BroadPhase::ParallelGrid,
+                          BroadPhase::SweepAndPrune, BroadPhase::HierarchicalGrid}) {
+            // The pair loop is quadratic, 100k balls would take minutes per iteration
+            if (mode == BroadPhase::BruteForce && count > 10000) continue;
+            bench->Args({count, static_cast<int64_t>(mode)});
+        }
+    }
+    bench->ArgNames({"balls", "broadphase"})->Unit(benchmark::kMicrosecond);
+}
+BENCHMARK_TEMPLATE(BM_ResolveCollisions, VerletBall)->Apply(solverArguments);
+BENCHMARK_TEMPLATE(BM_ResolveCollisions, EulerBall)->Apply(solverArguments);
+BENCHMARK_TEMPLATE(BM_ResolveCollisions, RK4Ball)->Apply(solverArguments);
+
+// Resolve collisions of range(0) dust balls of radius 1-2 around 20 boulders of radius 100,
+// range(1) broadphase. One cell size cannot fit both: the uniform grid sized for the boulders
+// tests every dust ball against hundreds of neighbours.
+static void BM_Polydisperse(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const auto mode    = static_cast<BroadPhase>(state.range(1));
+    std::vector<Wall> walls;
+
+    ParticleStore<VerletBall> initial;
+    initial.reserve(count + 20);
+    utils::Random randomizer(SEED);
+    for (size_t i{0}; i < count; ++i) {
+        const float x = randomizer.generateRandomFloat(2.f, width - 2.f);
+        const float y = randomizer.generateRandomFloat(2.f, height - 2.f);
+        initial.emplace_back(randomizer.generateRandomFloat(1.f, 2.f), {x, y}, 0.f, 0.f);
+    }
+    for (size_t i{0}; i < 20; ++i) {
+        const float x = randomizer.generateRandomFloat(100.f, width - 100.f);
+        const float y = randomizer.generateRandomFloat(100.f, height - 100.f);
+        initial.emplace_back(100.f, {x, y}, 0.f, 0.f);
+    }
+
+    Solver::setBroadPhase(mode);
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<VerletBall> balls = initial;
+        state.ResumeTiming();
+
+        Solver::resolveCollisions<VerletBall>(balls, walls);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * initial.size());
+    state.SetLabel(toString(mode));
+    state.counters["pairs_tested"] = static_cast<double>(Solver::getPairStats().tested);
+}
+static void polydisperseArguments(benchmark::internal::Benchmark* bench)
+{
+    for (int64_t count : {1000, 10000, 100000}) {
+        for (auto mode : {BroadPhase::Grid, BroadPhase::SweepAndPrune, BroadPhase::HierarchicalGrid}) {
+            // Boulder sized cells hold thousands of dust balls at 100k
+            if (mode == BroadPhase::Grid && count > 10000) continue;
+            bench->Args({count, static_cast<int64_t>(mode)});
+        }
+    }
+    bench->ArgNames({"balls", "broadphase"})->Unit(benchmark::kMillisecond);
+}
+BENCHMARK(BM_Polydisperse)->Apply(polydisperseArguments);
+
+// Resolve collisions of range(0) balls left in spawn order or sorted by Morton code once
+// (range(1)). Spawn order scatters the balls of a cell over the whole store.
+static void BM_SpatialOrder(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const bool sorted  = state.range(1) != 0;
+    std::vector<Wall> walls;
+
+    ParticleStore<VerletBall> initial;
+    initial.reserve(count);
+    fillRandom(initial, count);
+    if (sorted) Solver::reorderParticles(initial);
+
+    Solver::setBroadPhase(BroadPhase::Grid);
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<VerletBall> balls = initial;
+        state.ResumeTiming();
+
+        Solver::resolveCollisions<VerletBall>(balls, walls);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetLabel(sorted ? "morton" : "spawn order");
+}
+BENCHMARK(BM_SpatialOrder)->ArgsProduct({{100000, 1000000}, {0, 1}})->ArgNames({"balls", "sorted"})
+    ->Unit(benchmark::kMillisecond);
+
+// Cost of one reordering pass (Morton codes, radix sort, gathering every array) over range(0) balls
+static void BM_ReorderParticles(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    ParticleStore<VerletBall> initial;
+    initial.reserve(count);
+    fillRandom(initial, count);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<VerletBall> balls = initial;
+        state.ResumeTiming();
+
+        Solver::reorderParticles(balls);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ReorderParticles)->ArgName("balls")->RangeMultiplier(10)->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// Pair collisions of a random scene with the parallel grid, range(0) balls, contacts solved
+// in order, by colored batches or Jacobi (range(1))
+static void BM_ContactSolver(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const auto mode    = static_cast<ContactSolver>(state.range(1));
+    std::vector<Wall> walls;
+
+    ParticleStore<VerletBall> initial;
+    initial.reserve(count);
+    fillRandom(initial, count);
+
+    Solver::setBroadPhase(BroadPhase::ParallelGrid);
+    Solver::setContactSolver(mode);
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<VerletBall> balls = initial;
+        state.ResumeTiming();
+
+        Solver::resolveCollisions<VerletBall>(balls, walls);
+        benchmark::ClobberMemory();
+    }
+    Solver::setContactSolver(ContactSolver::GaussSeidel);
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetLabel(toString(mode));
+    state.counters["pairs_colliding"] = static_cast<double>(Solver::getPairStats().colliding);
+}
+BENCHMARK(BM_ContactSolver)->ArgsProduct({{10000, 100000}, {0, 1, 2}})->ArgNames({"balls", "contacts"})
+    ->Unit(benchmark::kMicrosecond);
+
+// One step of 10k resting balls with range(0) projectiles shot at 60 pixels per step across a
+// wall, continuous collisions off and on (range(1)). Reports how many projectiles ended up
+// behind the wall.
+static void BM_FastProjectiles(benchmark::State& state)
+{
+    const size_t shots = static_cast<size_t>(state.range(0));
+    const bool continuous = state.range(1) != 0;
+    std::vector<Wall> walls{Wall({500.f, 0.f}, 1000.f, 5.f, 90.f)};
+
+    ParticleStore<VerletBall> initial;
+    fillRandom(initial, 10000);
+    for (size_t i{0}; i < initial.size(); ++i) initial.setVelocity(i, {0.f, 0.f});
+    utils::Random randomizer(SEED);
+    for (size_t k{0}; k < shots; ++k) {
+        const float y = randomizer.generateRandomFloat(10.f, height - 10.f);
+        initial.emplace_back(3.f, {470.f, y}, 72.f, 0.f);   // 7200 pixels/s
+    }
+
+    Solver::setBroadPhase(BroadPhase::Grid);
+    Solver::setContinuous(continuous);
+    size_t tunnelled = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        ParticleStore<VerletBall> balls = initial;
+        state.ResumeTiming();
+
+        balls.updatePositions();
+        Solver::resolveCollisions<VerletBall>(balls, walls);
+        benchmark::ClobberMemory();
+
+        state.PauseTiming();
+        tunnelled = 0;
+        for (size_t i{initial.size() - shots}; i < balls.size(); ++i) tunnelled += balls.x[i] > 500.f;
+        state.ResumeTiming();
+    }
+    Solver::setContinuous(false);
+    state.SetLabel(continuous ? "continuous" : "discrete");
+    state.counters["tunnelled"] = static_cast<double>(tunnelled);
+}
+BENCHMARK(BM_FastProjectiles)->ArgsProduct({{10, 100}, {0, 1}})->ArgNames({"shots", "ccd"})->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char* argv[]) {
+    // Default to JSON on stdout so results can be diffed between builds
+    std::vector<char*> args(argv, argv + argc);
+    std::string json_format = "--benchmark_format=json";
+    bool has_format = false;
+    for (int i{1}; i < argc; ++i) {
+        if (std::string(argv[i]).rfind("--benchmark_format", 0) == 0) has_format = true;
+    }
+    if (!has_format) args.push_back(json_format.data());
+
+    int arg_count = static_cast<int>(args.size());
+    benchmark::Initialize(&arg_count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(arg_count, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -2,8 +2,13 @@
 
 #include <SFML/Graphics.hpp>
 #include <cmath>
+#include <iostream>
 #include <vector>
 #include "headers/ball.h"
+#include "headers/solver.h"
+#include "headers/renderer.h"
+#include "headers/render_frame.h"
+#include "headers/replay.h"
 
 
 class EventHandler {
@@ -11,14 +16,43 @@ private:
     sf::RenderWindow& window;
     sf::VertexArray trajectoryLine;
     sf::ConvexShape arrowhead;
+    BatchRenderer renderer;
+    bool show_profiler = false;
+
+    void batchDragArrow() {
+        if (trajectoryLine.getVertexCount() == 2) {
+            renderer.addLine(trajectoryLine[0].position, trajectoryLine[1].position, trajectoryLine[0].color);
+        }
+        if (arrowhead.getPointCount() == 3) {
+            const sf::Transform& transform = arrowhead.getTransform();
+            renderer.addTriangle(transform.transformPoint(arrowhead.getPoint(0)),
+                                 transform.transformPoint(arrowhead.getPoint(1)),
+                                 transform.transformPoint(arrowhead.getPoint(2)), arrowhead.getFillColor());
+        }
+    }
 public:
     EventHandler(sf::RenderWindow& window) : window(window)
     {
         trajectoryLine.setPrimitiveType(sf::Lines);
     };
 
-    template <typename T>
-    void dragAndShoot(const sf::Event& event, std::vector<T>& balls) {
+    // Balls is either a std::vector of balls or a ParticleStore.
+    // With a replay log the shot is queued for the given physics step instead of added right away.
+    template <typename Balls>
+    void dragAndShoot(const sf::Event& event, Balls& balls, ReplayLog* log = nullptr, uint64_t step = 0) {
+        aimAndFire(event, [&](float radius, sf::Vector2f position, float speed, float angle) {
+            if (log) {
+                log->record({step, radius, position.x, position.y, speed, angle});
+            } else {
+                balls.emplace_back(radius, Vec2(position), speed, angle);
+            }
+        });
+    }
+
+    // Same drag and release, fire(radius, position, speed, angle) decides what becomes of the shot
+    // (the windowed demo hands it to the simulation thread)
+    template <typename FireFn>
+    void aimAndFire(const sf::Event& event, FireFn&& fire) {
         static bool dragging = false;
         static sf::Vector2f initial_position;
         static sf::Vector2f target_position;
@@ -68,37 +102,88 @@ public:
                 float speed = magnitude / 20.f;
                 float angle = std::atan2(direction.y, direction.x);
 
-                T new_ball(20.f, target_position, speed, angle);
-                balls.emplace_back(std::move(new_ball));
+                fire(20.f, target_position, speed, angle);
             }
             // Clear the arrow
             arrowhead.setPointCount(0); 
         }
     }
 
-    void drawDragArrow() {
-        window.draw(trajectoryLine);  // Draw the stored trajectory line
-        window.draw(arrowhead);
-    }
-
     void closeWindow(const sf::Event& event){
         if (event.type == sf::Event::Closed || sf::Keyboard::isKeyPressed(sf::Keyboard::Escape)) {
             window.close();
         }
     }
 
+    // Press B to cycle through grid, parallel grid, sweep and prune and the brute-force pair loop
+    void toggleBroadPhase(const sf::Event& event){
+        if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::B) {
+            switch (Solver::getBroadPhase()) {
+                case BroadPhase::Grid:             Solver::setBroadPhase(BroadPhase::ParallelGrid);     break;
+                case BroadPhase::ParallelGrid:     Solver::setBroadPhase(BroadPhase::SweepAndPrune);    break;
+                case BroadPhase::SweepAndPrune:    Solver::setBroadPhase(BroadPhase::HierarchicalGrid); break;
+                case BroadPhase::HierarchicalGrid: Solver::setBroadPhase(BroadPhase::BruteForce);       break;
+                case BroadPhase::BruteForce:       Solver::setBroadPhase(BroadPhase::Grid);             break;
+            }
+        }
+    }
+
+    // Press C to cycle how the grid broadphases solve their contacts: in order, by colored batches or Jacobi
+    void toggleContactSolver(const sf::Event& event){
+        if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::C) {
+            switch (Solver::getContactSolver()) {
+                case ContactSolver::GaussSeidel: Solver::setContactSolver(ContactSolver::Colored);     break;
+                case ContactSolver::Colored:     Solver::setContactSolver(ContactSolver::Jacobi);      break;
+                case ContactSolver::Jacobi:      Solver::setContactSolver(ContactSolver::GaussSeidel); break;
+            }
+        }
+    }
+
+    // P shows the per-phase profiler overlay, T starts and stops a Chrome trace written to trace.json
+    void handleProfilerKeys(const sf::Event& event){
+        if (event.type != sf::Event::KeyPressed) return;
+        if (event.key.code == sf::Keyboard::P) {
+            show_profiler = !show_profiler;
+        }
+        if (event.key.code == sf::Keyboard::T) {
+            utils::Profiler& profiler = utils::Profiler::instance();
+            if (!profiler.isTracing()) {
+                profiler.startTrace();
+            } else if (profiler.stopTrace("trace.json")) {
+                std::cout << "Trace written to trace.json" << std::endl;
+            }
+        }
+    }
+
+    [[nodiscard]] bool isProfilerVisible() const { return show_profiler;}
+
     void drawWall(const std::vector<Wall>& walls){
         for(auto& wall : walls){
             wall.draw(window);
         }
     }
 
+    // Drawing only, the balls are advanced by the physics step
     template <typename T>
     void drawBall(std::vector<T>& balls, bool draw_path = false){
         for (auto& ball : balls) {
             ball.draw(window);
-            ball.updatePosition();
             if(draw_path) ball.drawPath(window);
         }
     }
+
+    template <typename T>
+    void drawBall(const ParticleStore<T>& balls, float alpha = 1.f){
+        balls.draw(window, alpha);
+    }
+
+    // Walls, balls and the drag arrow of a frame published by the simulation thread, in a single
+    // draw call
+    void drawScene(const RenderFrame& frame, float alpha = 1.f){
+        renderer.clear();
+        renderer.addWalls(frame.walls);
+        renderer.addBalls(frame, alpha);
+        batchDragArrow();
+        renderer.draw(window);
+    }
 };
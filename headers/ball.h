@@ -1,7 +1,9 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <vector>
+#include "scalar.h"
 #include "wall.h"
 
 #define HAVE_SFML
@@ -11,45 +13,53 @@
 using namespace mathematical;
 using namespace earth;
 
-constexpr float SCALE                = 100.f;    // 1 meter = 100 pixels
-constexpr float RESTITUTION          = 0.8f;     // Energy retention coefficient/response coefficient (0-1)
-constexpr float FRICTION_COEFFICIENT = 0.5f;     // Friction coefficient for floor contact
-constexpr float EPSILON              = 1e-4f;    // tolerance
-constexpr float ENERGY_LOST_FACTOR   = 1.f - RESTITUTION * RESTITUTION;
-const sf::Vector2f ACCELERATION      = SCALE * sf::Vector2f{0.f, g_f};
+constexpr Scalar SCALE                = 100.f;    // 1 meter = 100 pixels
+constexpr Scalar RESTITUTION          = 0.8f;     // Energy retention coefficient/response coefficient (0-1)
+constexpr Scalar FRICTION_COEFFICIENT = 0.5f;     // Friction coefficient for floor contact
+constexpr Scalar EPSILON              = 1e-4f;    // tolerance
+const Scalar ENERGY_LOST_FACTOR       = Scalar(1) - RESTITUTION * RESTITUTION;
+const Vec2 ACCELERATION               = SCALE * Vec2{Scalar(0), Scalar(g_f)};
 
 // Abstract class
 class Ball {
 protected:
     sf::CircleShape circleObject;
-    float deltaTime;
-    sf::VertexArray path;
+    Scalar deltaTime;
 
-    Ball(float radius, sf::Vector2f init_position, float init_speed, float angle): 
+    // Trajectory for drawPath, a ring of the last PATH_LENGTH positions stored twice
+    // so that the newest ones are always contiguous. Allocated on the first drawPath.
+    static constexpr size_t PATH_LENGTH = 256;
+    std::vector<sf::Vertex> path;
+    size_t path_head  = 0;
+    size_t path_count = 0;
+
+    Ball(Scalar radius, Vec2 init_position, Scalar init_speed, Scalar angle): 
         radius(radius),
         position(init_position),
-        velocity(std::cos(angle) * init_speed * SCALE, std::sin(angle) * init_speed * SCALE)
+        velocity(utils::cos(angle) * init_speed * SCALE, utils::sin(angle) * init_speed * SCALE)
     {
-        circleObject.setRadius(radius);
-        circleObject.setOrigin(radius, radius);
-        circleObject.setPosition(init_position);
+        circleObject.setRadius(static_cast<float>(radius));
+        circleObject.setOrigin(static_cast<float>(radius), static_cast<float>(radius));
+        setShapePosition(init_position);
         setColor();
-        setStepSize(1.f/120.f);
+        setStepSize(Scalar(1) / Scalar(120));
     }
+
+    void setShapePosition(Vec2 centre) { circleObject.setPosition(sf::Vector2f(centre));}
 public:
-    const float  radius;
-    sf::Vector2f position;
-    sf::Vector2f velocity;
-    sf::Vector2f acceleration{ACCELERATION};
+    const Scalar radius;
+    Vec2 position;
+    Vec2 velocity;
+    Vec2 acceleration{ACCELERATION};
 
     void setColor() { circleObject.setFillColor(sf::Color(0, 176, 255));}
     void setColor(const sf::Color& color) {circleObject.setFillColor(color);}
-    void setStepSize() {deltaTime = 1.f / 60.f;}
-    void setStepSize(const float& dt) {deltaTime = dt;}
+    void setStepSize() {deltaTime = Scalar(1) / Scalar(60);}
+    void setStepSize(const Scalar& dt) {deltaTime = dt;}
 
     //virtual void updatePosition() = 0;
     
-    [[nodiscard]] float getStepSize() const
+    [[nodiscard]] Scalar getStepSize() const
     {
         return deltaTime;
     }
@@ -61,10 +71,14 @@ public:
 
     void drawPath(sf::RenderWindow& window) 
     {
-        const sf::Color pathColor = circleObject.getFillColor();
-        path.setPrimitiveType(sf::Lines);
-        path.append(sf::Vertex(circleObject.getPosition(), pathColor)); // add current position to the path
-        window.draw(path);
+        if (path.empty()) path.resize(2 * PATH_LENGTH);
+
+        // add current position to the path, the oldest one drops out once the ring is full
+        const sf::Vertex point(circleObject.getPosition(), circleObject.getFillColor());
+        path[path_head] = path[path_head + PATH_LENGTH] = point;
+        path_head  = (path_head + 1) % PATH_LENGTH;
+        path_count = std::min(path_count + 1, PATH_LENGTH);
+        window.draw(&path[path_head + PATH_LENGTH - path_count], path_count, sf::LineStrip);
     }
 
     void draw(sf::RenderWindow& window) const 
@@ -0,0 +1,173 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Barnes–Hut quadtree for mutual gravity between n bodies in O(n log n)
+// Built again every step from the body positions and masses. A cell seen from far enough away
+// (side / distance < theta) pulls like a single body at its centre of mass, closer cells are opened.
+// Leaves hold a few bodies, summed exactly. The arrays are kept between builds, so once they
+// have grown to the body count a step does not allocate.
+class BarnesHut {
+private:
+    // Children of a node are consecutive, child_count of them starting at first_child.
+    // Leaves own bodies[first, first + count).
+    struct Node {
+        Scalar com_x = 0.f, com_y = 0.f;   // centre of mass
+        Scalar mass  = 0.f;
+        Scalar size  = 0.f;                // side of the square cell
+        uint32_t first_child = 0;
+        uint32_t child_count = 0;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    static constexpr uint32_t LEAF_SIZE = 8;
+    static constexpr size_t MAX_DEPTH   = 32;     // bodies closer than the cell size at this depth share a leaf
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items;                  // body indices, grouped by leaf
+    std::vector<Scalar> body_x, body_y, body_mass; // bodies in items order, for the leaf loops
+
+    void build(uint32_t index, uint32_t first, uint32_t last, Scalar left, Scalar top, Scalar size, size_t depth)
+    {
+        nodes[index].size = size;
+        if (last - first <= LEAF_SIZE || depth + 1 >= MAX_DEPTH) {
+            Scalar mass = 0.f, mx = 0.f, my = 0.f;
+            for (uint32_t k{first}; k < last; ++k) {
+                mass += body_mass[k];
+                mx   += body_mass[k] * body_x[k];
+                my   += body_mass[k] * body_y[k];
+            }
+            Node& node = nodes[index];
+            node.first = first;
+            node.count = last - first;
+            node.mass  = mass;
+            node.com_x = mass > 0.f ? mx / mass : body_x[first];
+            node.com_y = mass > 0.f ? my / mass : body_y[first];
+            return;
+        }
+
+        // Split into quadrants, top half first, then left before right in each half
+        const Scalar half = 0.5f * size;
+        const Scalar mid_x = left + half, mid_y = top + half;
+        auto split = [&](uint32_t from, uint32_t to, auto&& in_first) {
+            uint32_t middle = from;
+            for (uint32_t k{from}; k < to; ++k) {
+                if (!in_first(k)) continue;
+                std::swap(items[k], items[middle]);
+                std::swap(body_x[k], body_x[middle]);
+                std::swap(body_y[k], body_y[middle]);
+                std::swap(body_mass[k], body_mass[middle]);
+                ++middle;
+            }
+            return middle;
+        };
+        const uint32_t middle = split(first, last, [&](uint32_t k) { return body_y[k] < mid_y;});
+        const uint32_t bounds[5] = {
+            first,
+            split(first, middle, [&](uint32_t k) { return body_x[k] < mid_x;}),
+            middle,
+            split(middle, last, [&](uint32_t k) { return body_x[k] < mid_x;}),
+            last
+        };
+
+        uint32_t child = static_cast<uint32_t>(nodes.size());
+        uint32_t child_count = 0;
+        for (int q{0}; q < 4; ++q) child_count += bounds[q] < bounds[q + 1];
+        nodes.resize(nodes.size() + child_count);
+        nodes[index].first_child = child;
+        nodes[index].child_count = child_count;
+
+        Scalar mass = 0.f, mx = 0.f, my = 0.f;
+        for (int q{0}; q < 4; ++q) {
+            if (bounds[q] == bounds[q + 1]) continue;
+            build(child, bounds[q], bounds[q + 1], left + (q & 1) * half, top + (q >> 1) * half, half, depth + 1);
+            mass += nodes[child].mass;
+            mx   += nodes[child].mass * nodes[child].com_x;
+            my   += nodes[child].mass * nodes[child].com_y;
+            ++child;
+        }
+        Node& node = nodes[index];
+        node.mass  = mass;
+        node.com_x = mass > 0.f ? mx / mass : left + half;
+        node.com_y = mass > 0.f ? my / mass : top + half;
+    }
+
+public:
+    // Largest opening angle at which a cell is never approximated as seen from a body inside it
+    static constexpr float MAX_THETA = 0.7f;
+
+    // x, y and mass have count entries each
+    void build(const Scalar* x, const Scalar* y, const Scalar* mass, size_t count)
+    {
+        nodes.clear();
+        if (count == 0) return;
+
+        items.resize(count);
+        body_x.assign(x, x + count);
+        body_y.assign(y, y + count);
+        body_mass.assign(mass, mass + count);
+
+        Scalar min_x = x[0], max_x = x[0], min_y = y[0], max_y = y[0];
+        for (size_t i{0}; i < count; ++i) {
+            items[i] = static_cast<uint32_t>(i);
+            min_x = std::min(min_x, x[i]);     max_x = std::max(max_x, x[i]);
+            min_y = std::min(min_y, y[i]);     max_y = std::max(max_y, y[i]);
+        }
+        // Padded so that bodies on the far edge still fall inside
+        const Scalar size = std::max(max_x - min_x, max_y - min_y) * 1.0001f + 1e-3f;
+
+        nodes.reserve(count / 2 + 1);
+        nodes.emplace_back();
+        build(0, 0, static_cast<uint32_t>(count), min_x, min_y, size, 0);
+    }
+
+    // Acceleration of body i at (px, py), in units of the gravitational constant.
+    // softening (pixels) keeps close encounters finite, theta trades accuracy for speed
+    // (0 is exact, 0.5 is within about 1%), at most MAX_THETA.
+    [[nodiscard]] Vec2 acceleration(uint32_t i, Scalar px, Scalar py, Scalar theta, Scalar softening) const
+    {
+        if (nodes.empty()) return {};
+        const Scalar theta2 = theta * theta;
+        const Scalar soft2  = softening * softening;
+        Scalar ax = 0.f, ay = 0.f;
+        auto pull = [&](Scalar mass, Scalar cx, Scalar cy) {
+            const Scalar dx = cx - px, dy = cy - py;
+            const Scalar d2 = dx * dx + dy * dy + soft2;
+            const Scalar inverse = 1.f / utils::sqrt(d2);
+            const Scalar strength = mass * inverse * inverse * inverse;
+            ax += strength * dx;
+            ay += strength * dy;
+        };
+
+        uint32_t stack[4 * MAX_DEPTH + 1];
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (node.count > 0) {
+                for (uint32_t k{node.first}; k < node.first + node.count; ++k) {
+                    if (items[k] != i) pull(body_mass[k], body_x[k], body_y[k]);
+                }
+                continue;
+            }
+            const Scalar dx = node.com_x - px, dy = node.com_y - py;
+            if (node.size * node.size < theta2 * (dx * dx + dy * dy)) {
+                pull(node.mass, node.com_x, node.com_y);
+                continue;
+            }
+            for (uint32_t c{0}; c < node.child_count; ++c) stack[top++] = node.first_child + c;
+        }
+        return {ax, ay};
+    }
+
+    // Bodies in tree order, neighbours in space are neighbours here. Walking the bodies in this
+    // order keeps consecutive traversals on the same nodes.
+    [[nodiscard]] uint32_t getBody(size_t k) const { return items[k];}
+
+    [[nodiscard]] size_t getNodeCount() const { return nodes.size();}
+    [[nodiscard]] bool empty() const { return nodes.empty();}
+};
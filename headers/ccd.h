@@ -0,0 +1,83 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include "wall.h"
+
+// Continuous collision detection: time of impact of a circle swept from p to p + d.
+// Times are fractions of the sweep in [0, 1], NO_HIT when the circle does not touch the obstacle
+// on the way or already touches it at the start (the discrete checks handle resting contact).
+// normal is set on a hit, the unit vector from the circle centre towards the obstacle.
+namespace ccd {
+
+inline constexpr Scalar NO_HIT = 2.f;
+
+// Against a circle of radius reach (sum of both radii) centred at c
+inline Scalar sweepCircle(Vec2 p, Vec2 d, Scalar reach, Vec2 c, Vec2& normal)
+{
+    const Vec2 m = p - c;
+    const Scalar a = utils::dot(d, d);
+    const Scalar b = utils::dot(m, d);
+    const Scalar inside = utils::dot(m, m) - reach * reach;
+    if (inside <= 0.f || b >= 0.f || a <= 0.f) return NO_HIT;
+
+    const Scalar discriminant = b * b - a * inside;
+    if (discriminant < 0.f) return NO_HIT;
+    const Scalar t = (-b - utils::sqrt(discriminant)) / a;
+    if (t > 1.f) return NO_HIT;
+    normal = utils::normalize(c - (p + d * t));
+    return t;
+}
+
+// Against the segment of a wall, walls being as thin as the discrete check sees them
+inline Scalar sweepWall(Vec2 p, Vec2 d, Scalar radius, const Wall& wall, Vec2& normal)
+{
+    const Vec2 a = wall.getStartingPoint(), b = wall.getEndingPoint();
+    if (utils::norm2f(closestPointToWall(p, wall) - p) < radius) return NO_HIT;
+
+    Scalar best = NO_HIT;
+    const Vec2 axis = wall.getDirection();
+    const Vec2 side_normal{-axis.y, axis.x};
+    const Scalar start = utils::dot(p - a, side_normal);
+    const Scalar speed = utils::dot(d, side_normal);
+    if (start * speed < 0.f) {
+        // Face of the segment on the side the circle starts from
+        const Scalar side = start > 0.f ? 1.f : -1.f;
+        const Scalar t = (side * radius - start) / speed;
+        const Scalar along = utils::dot(p + d * t - a, axis);
+        if (t >= 0.f && t <= 1.f && along >= 0.f && along <= wall.getLength()) {
+            best   = t;
+            normal = -side * side_normal;
+        }
+    }
+
+    // Rounded ends
+    for (const Vec2 end : {a, b}) {
+        Vec2 end_normal;
+        const Scalar t = sweepCircle(p, d, radius, end, end_normal);
+        if (t < best) {
+            best   = t;
+            normal = end_normal;
+        }
+    }
+    return best;
+}
+
+// Against the window borders
+inline Scalar sweepBorder(Vec2 p, Vec2 d, Scalar radius, Scalar width, Scalar height, Vec2& normal)
+{
+    Scalar best = NO_HIT;
+    auto cross = [&](Scalar start, Scalar step, Scalar low, Scalar high, Vec2 axis) {
+        Scalar t = NO_HIT;
+        if (step > 0.f && start <= high && start + step > high) t = (high - start) / step;
+        if (step < 0.f && start >= low && start + step < low)   t = (low - start) / step;
+        if (t < best) {
+            best   = t;
+            normal = step > 0.f ? axis : -axis;
+        }
+    };
+    cross(p.x, d.x, radius, width - radius, {1.f, 0.f});
+    cross(p.y, d.y, radius, height - radius, {0.f, 1.f});
+    return best;
+}
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Contacts of one step as a graph over the balls, for solving them in parallel
+// Coloring groups the contacts into batches in which no ball appears twice, so all contacts of
+// a batch can be corrected at the same time without two threads moving the same ball.
+// The adjacency lists let every ball sum up its own contacts instead (Jacobi).
+// All arrays are kept between steps, so once they have grown a step does not allocate.
+class ContactGraph {
+public:
+    struct Contact {
+        uint32_t a, b;
+    };
+
+private:
+    static constexpr uint32_t MAX_COLORS = 64;      // one bit per color, contacts beyond go to a last serial batch
+
+    std::vector<Contact> contacts;
+    std::vector<Contact> colored;                   // contacts grouped by color
+    std::vector<uint32_t> batch_start;              // batch k owns colored[batch_start[k], batch_start[k + 1])
+    std::vector<uint32_t> contact_color;
+    std::vector<uint64_t> used_colors;              // colors taken by the contacts of each ball so far
+    std::vector<uint32_t> adjacency_start;          // ball i touches neighbours[adjacency_start[i], adjacency_start[i + 1])
+    std::vector<uint32_t> neighbours;
+    std::vector<uint32_t> cursor;                   // insertion cursor per bucket while sorting
+
+public:
+    // Room for contact_count contacts between ball_count balls, so that steps within both do not allocate
+    void reserve(size_t ball_count, size_t contact_count)
+    {
+        contacts.reserve(contact_count);
+        colored.reserve(contact_count);
+        contact_color.reserve(contact_count);
+        neighbours.reserve(2 * contact_count);
+        used_colors.reserve(ball_count);
+        adjacency_start.reserve(ball_count + 1);
+        cursor.reserve(std::max<size_t>(ball_count, MAX_COLORS + 1));
+        batch_start.reserve(MAX_COLORS + 2);
+    }
+
+    void clear() { contacts.clear();}
+    void add(uint32_t a, uint32_t b) { contacts.push_back({a, b});}
+
+    template <typename Contacts>
+    void append(const Contacts& more) { contacts.insert(contacts.end(), more.begin(), more.end());}
+
+    // Greedy coloring in contact order: each contact takes the lowest color neither of its balls has yet
+    void color(size_t ball_count)
+    {
+        used_colors.assign(ball_count, 0);
+        contact_color.resize(contacts.size());
+        batch_start.assign(MAX_COLORS + 2, 0);
+
+        uint32_t color_count = 0;
+        for (size_t k{0}; k < contacts.size(); ++k) {
+            const Contact& contact = contacts[k];
+            const uint64_t used = used_colors[contact.a] | used_colors[contact.b];
+            uint32_t color = 0;
+            while (color < MAX_COLORS && ((used >> color) & 1)) ++color;
+            if (color < MAX_COLORS) {
+                used_colors[contact.a] |= uint64_t{1} << color;
+                used_colors[contact.b] |= uint64_t{1} << color;
+            }
+            contact_color[k] = color;
+            ++batch_start[color + 1];
+            color_count = std::max(color_count, color + 1);
+        }
+
+        // Counting sort by color
+        batch_start.resize(color_count + 1);
+        for (uint32_t c{0}; c < color_count; ++c) batch_start[c + 1] += batch_start[c];
+        colored.resize(contacts.size());
+        cursor.assign(batch_start.begin(), batch_start.end() - 1);
+        for (size_t k{0}; k < contacts.size(); ++k) colored[cursor[contact_color[k]]++] = contacts[k];
+    }
+
+    // Both directions of every contact, grouped by ball
+    void buildAdjacency(size_t ball_count)
+    {
+        adjacency_start.assign(ball_count + 1, 0);
+        for (const Contact& contact : contacts) {
+            ++adjacency_start[contact.a + 1];
+            ++adjacency_start[contact.b + 1];
+        }
+        for (size_t i{0}; i < ball_count; ++i) adjacency_start[i + 1] += adjacency_start[i];
+
+        neighbours.resize(2 * contacts.size());
+        cursor.assign(adjacency_start.begin(), adjacency_start.end() - 1);
+        for (const Contact& contact : contacts) {
+            neighbours[cursor[contact.a]++] = contact.b;
+            neighbours[cursor[contact.b]++] = contact.a;
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return contacts.size();}
+    [[nodiscard]] bool empty() const { return contacts.empty();}
+    [[nodiscard]] const Contact& operator[](size_t k) const { return contacts[k];}
+
+    // After color(): batches in color order, the last one may hold contacts past MAX_COLORS
+    // that share balls and must be solved one after the other
+    [[nodiscard]] size_t getBatchCount() const { return batch_start.empty() ? 0 : batch_start.size() - 1;}
+    [[nodiscard]] const Contact* batchBegin(size_t k) const { return colored.data() + batch_start[k];}
+    [[nodiscard]] size_t batchSize(size_t k) const { return batch_start[k + 1] - batch_start[k];}
+    [[nodiscard]] bool isSerialBatch(size_t k) const { return k == MAX_COLORS;}
+
+    // After buildAdjacency()
+    [[nodiscard]] const uint32_t* neighboursBegin(size_t i) const { return neighbours.data() + adjacency_start[i];}
+    [[nodiscard]] const uint32_t* neighboursEnd(size_t i) const { return neighbours.data() + adjacency_start[i + 1];}
+};
@@ -1,12 +1,16 @@
 #pragma once
 #include "ball.h"
+#include "particles.h"
+#include "forces.h"
+
+class ImplicitEulerBall;
 
 
 class EulerBall : public Ball{
 private:
-    const float gravity = acceleration.y; // Constant gravitational acceleration in pixels/s²
+    const Scalar gravity = acceleration.y; // Constant gravitational acceleration in pixels/s²
 public:
-    EulerBall(float radius, sf::Vector2f init_position, float init_speed, float angle)
+    EulerBall(Scalar radius, Vec2 init_position, Scalar init_speed, Scalar angle)
         : Ball(radius, init_position, init_speed, angle)
     {}
 
@@ -16,32 +20,32 @@ public:
         // x' = x + v dt
         velocity += acceleration * deltaTime;
         position += velocity * deltaTime;
-        circleObject.setPosition(position);
+        setShapePosition(position);
     }
 
-    [[nodiscard]] sf::Vector2f getPosition() const
+    [[nodiscard]] Vec2 getPosition() const
     {
         return position;
     }
 
-    [[nodiscard]] sf::Vector2f getVelocity() const
+    [[nodiscard]] Vec2 getVelocity() const
     {
         return velocity;
     }
 
-    [[nodiscard]] float getSpeed() const noexcept
+    [[nodiscard]] Scalar getSpeed() const noexcept
     {
         return utils::norm2f(velocity);
     }
 
     void drawVelocityVector(sf::RenderWindow& window)
     {
-        float length = getSpeed() / 5.f;
+        float length = static_cast<float>(getSpeed()) / 5.f;
         sf::RectangleShape line;
         line.setSize(sf::Vector2f(length, 2.f));
-        line.setPosition(position);
+        line.setPosition(sf::Vector2f(position));
         line.setFillColor(sf::Color::Red);
-        float angle = std::atan2(velocity.y, velocity.x);
+        float angle = std::atan2(static_cast<float>(velocity.y), static_cast<float>(velocity.x));
         line.setRotation(angle * 180.f / PI_f);
         window.draw(line);
     }
@@ -50,17 +54,32 @@ public:
 };
 
 
+template<>
+inline void ParticleStore<EulerBall>::updatePositions(size_t first, size_t last)
+{
+    // v' = v + a dt
+    // x' = x + v dt
+    const bool interacting = hasInteractions();
+    for (size_t i{first}; i < last; ++i) {
+        if (asleep[i]) continue;
+        Vec2 acceleration = Forces::at({x[i], y[i]}, {vx[i], vy[i]});
+        if (interacting) acceleration += Vec2{ax[i], ay[i]};
+        vx[i] += acceleration.x * deltaTime;
+        vy[i] += acceleration.y * deltaTime;
+        x[i] += vx[i] * deltaTime;
+        y[i] += vy[i] * deltaTime;
+    }
+}
+
+
 template<>
 class CollisionSolver<EulerBall> {
     CollisionSolver() = default;
+    friend class CollisionSolver<ImplicitEulerBall>;  // shares the impulses
 
-public:
-    static void handleBorderCollision(EulerBall& ball, const int windowWidth, const int windowHeight) 
+    static void bounceOffBorder(Vec2& position, Vec2& velocity, const Scalar radius,
+                                const int windowWidth, const int windowHeight)
     {
-        auto& position = ball.position;
-        auto& velocity = ball.velocity;
-        const float radius = ball.radius;
-
         if (position.x + radius >= windowWidth) {
             position.x = windowWidth - radius;
             velocity.x *= -RESTITUTION;
@@ -77,71 +96,122 @@ public:
             position.y = radius;
             velocity.y *= -RESTITUTION;
         }
-
-        // Apply corrections to both circleObject and ball.position
-        ball.circleObject.setPosition(position);
     }
 
-    // Impulse based collision
-    static void resolvePairCollision(EulerBall& ballA, EulerBall& ballB) 
+    // Impulse based collision, returns false if the balls do not touch
+    static bool collide(Vec2& posA, Vec2& posB, Vec2& velA, Vec2& velB,
+                        const Scalar radiusA, const Scalar radiusB)
     {
-        sf::Vector2f& posA = ballA.position;
-        sf::Vector2f& posB = ballB.position;
-        sf::Vector2f& velA = ballA.velocity;
-        sf::Vector2f& velB = ballB.velocity;
-
-        sf::Vector2f delta = posB - posA;
-        float dist2        = delta.x * delta.x + delta.y * delta.y;
-        float min_dist     = ballA.radius + ballB.radius;
+        Vec2 delta = posB - posA;
+        Scalar dist2        = delta.x * delta.x + delta.y * delta.y;
+        Scalar min_dist     = radiusA + radiusB;
 
         if (dist2 < min_dist * min_dist) {
-            float dist = std::sqrt(dist2);
-            float overlap = min_dist - dist;
-            sf::Vector2f normal = delta / dist;
+            Scalar dist = utils::sqrt(dist2);
+            Scalar overlap = min_dist - dist;
+            // Coincident centres (both clamped into the same corner) part along x
+            Vec2 normal = dist > Scalar(0) ? delta / dist : Vec2{1.f, 0.f};
 
-            const float mass_ratioA = ballA.radius / min_dist;
-            const float mass_ratioB = ballB.radius / min_dist;
+            const Scalar mass_ratioA = radiusA / min_dist;
+            const Scalar mass_ratioB = radiusB / min_dist;
 
-            sf::Vector2f correction = normal * overlap;
+            Vec2 correction = normal * overlap;
             posA -= correction * mass_ratioB;
             posB += correction * mass_ratioA;
 
-            sf::Vector2f relative_velocity = velB - velA;
-            float velocity_along_normal = utils::dot(relative_velocity, normal);
+            Vec2 relative_velocity = velB - velA;
+            Scalar velocity_along_normal = utils::dot(relative_velocity, normal);
 
             // Only resolve if moving towards each other
             if (velocity_along_normal < 0)
             {
-                float impulse_scalar = -(1.f + RESTITUTION) * velocity_along_normal;
-                sf::Vector2f impulse = impulse_scalar * normal;
+                Scalar impulse_scalar = -(1.f + RESTITUTION) * velocity_along_normal;
+                Vec2 impulse = impulse_scalar * normal;
                 velA -= impulse * mass_ratioB;
                 velB += impulse * mass_ratioA;
-                
-            }
 
-            ballA.circleObject.setPosition(posA);
-            ballB.circleObject.setPosition(posB);
+            }
+            return true;
         }
-
+        return false;
     }
 
-    static void resolveWallCollision(EulerBall& ball, Wall& wall) 
+    static bool bounceOffWall(Vec2& position, Vec2& velocity, const Scalar radius, const Wall& wall)
     {
-        sf::Vector2f closest_point = closestPointToWall(ball, wall);
-        sf::Vector2f ball_to_closest = closest_point - ball.position;
-        float dist = utils::norm2f(ball_to_closest);
-        sf::Vector2f normal = utils::normalize(ball_to_closest);
+        Vec2 closest_point = closestPointToWall(position, wall);
+        Vec2 ball_to_closest = closest_point - position;
+        Scalar dist = utils::norm2f(ball_to_closest);
+        Vec2 normal = utils::normalize(ball_to_closest);
 
-        float overlap = ball.radius - dist;
-        if (dist < ball.radius) {
+        Scalar overlap = radius - dist;
+        if (dist < radius) {
             // Position correction (push ball out of wall)
-            ball.position -= normal * overlap;
-            ball.circleObject.setPosition(ball.position);
+            position -= normal * overlap;
 
             // Reflect velocity using proper restitution
-            float velocity_along_normal = utils::dot(ball.velocity, normal);
-            ball.velocity -= (1.f + RESTITUTION) * velocity_along_normal * normal;
-            ball.velocity *= wall.WALL_FRICTION;
+            Scalar velocity_along_normal = utils::dot(velocity, normal);
+            velocity -= (1.f + RESTITUTION) * velocity_along_normal * normal;
+            velocity *= wall.WALL_FRICTION;
+            return true;
+        }
+        return false;
+    }
+
+public:
+    static void handleBorderCollision(EulerBall& ball, const int windowWidth, const int windowHeight)
+    {
+        bounceOffBorder(ball.position, ball.velocity, ball.radius, windowWidth, windowHeight);
+
+        // Apply corrections to both circleObject and ball.position
+        ball.setShapePosition(ball.position);
+    }
+
+    static bool resolvePairCollision(EulerBall& ballA, EulerBall& ballB)
+    {
+        if (collide(ballA.position, ballB.position, ballA.velocity, ballB.velocity, ballA.radius, ballB.radius)) {
+            ballA.setShapePosition(ballA.position);
+            ballB.setShapePosition(ballB.position);
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(EulerBall& ball, const Wall& wall)
+    {
+        if (bounceOffWall(ball.position, ball.velocity, ball.radius, wall)) {
+            ball.setShapePosition(ball.position);
+        }
+    }
+
+    // Structure-of-arrays versions, i and j index into the store
+    static void handleBorderCollision(ParticleStore<EulerBall>& balls, size_t i, const int windowWidth, const int windowHeight)
+    {
+        Vec2 position{balls.x[i], balls.y[i]};
+        Vec2 velocity{balls.vx[i], balls.vy[i]};
+        bounceOffBorder(position, velocity, balls.radius[i], windowWidth, windowHeight);
+        balls.x[i] = position.x;     balls.y[i] = position.y;
+        balls.vx[i] = velocity.x;    balls.vy[i] = velocity.y;
+    }
+
+    static bool resolvePairCollision(ParticleStore<EulerBall>& balls, size_t i, size_t j)
+    {
+        Vec2 posA{balls.x[i], balls.y[i]},   posB{balls.x[j], balls.y[j]};
+        Vec2 velA{balls.vx[i], balls.vy[i]}, velB{balls.vx[j], balls.vy[j]};
+        if (collide(posA, posB, velA, velB, balls.radius[i], balls.radius[j])) {
+            balls.x[i] = posA.x;     balls.y[i] = posA.y;     balls.x[j] = posB.x;     balls.y[j] = posB.y;
+            balls.vx[i] = velA.x;    balls.vy[i] = velA.y;    balls.vx[j] = velB.x;    balls.vy[j] = velB.y;
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(ParticleStore<EulerBall>& balls, size_t i, const Wall& wall)
+    {
+        Vec2 position{balls.x[i], balls.y[i]};
+        Vec2 velocity{balls.vx[i], balls.vy[i]};
+        if (bounceOffWall(position, velocity, balls.radius[i], wall)) {
+            balls.x[i] = position.x;     balls.y[i] = position.y;
+            balls.vx[i] = velocity.x;    balls.vy[i] = velocity.y;
         }
     }
 };
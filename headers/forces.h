@@ -0,0 +1,222 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "ball.h"
+#include "particles.h"
+#include "barnes_hut.h"
+#include "thread_pool.h"
+
+// Force fields acting on the balls, composed by adding their accelerations.
+//
+// Local fields depend on a ball's own position and velocity only (uniform gravity, drag, point
+// attractors). Integrators evaluate them through Forces::at wherever they need an acceleration,
+// RK4 and RK45 at every stage.
+// Interactions depend on other balls (springs, mutual gravity). accumulate() computes them once
+// per step, before integration, into ParticleStore::ax and ay, and integrators hold them constant
+// over the step. Mutual gravity goes through a Barnes–Hut tree, so 100k bodies stay affordable.
+// Masses are proportional to the ball area (radius²).
+
+// Pulls towards center with strength / distance², softened within softening pixels
+struct Attractor {
+    Vec2 center;
+    Scalar strength  = 1e7f;     // pixels³/s²
+    Scalar softening = 10.f;
+};
+
+// Keeps two balls rest_length apart
+struct Spring {
+    ParticleHandle a, b;
+    Scalar rest_length = 50.f;
+    Scalar stiffness   = 100.f;  // 1/s², acceleration per pixel of stretch
+    Scalar damping     = 0.f;    // 1/s, acceleration per pixel/s of stretching speed
+};
+
+// Mutual gravity between every pair of balls
+struct Gravitation {
+    bool enabled    = false;
+    Scalar constant  = 1000.f;   // acceleration of a ball 1 pixel from a ball of mass 1 (radius 1)
+    Scalar theta     = 0.5f;     // Barnes–Hut opening angle, 0 = exact pairwise sum, at most BarnesHut::MAX_THETA
+    Scalar softening = 2.f;      // pixels
+};
+
+// Derivative of the local acceleration with respect to the position, symmetric for these fields
+struct FieldGradient {
+    Scalar xx = 0.f, xy = 0.f, yy = 0.f;
+};
+
+class Forces {
+private:
+    Forces() = default;
+    static inline Vec2 uniform = ACCELERATION;
+    static inline Scalar drag = 0.f;
+    static inline std::vector<Attractor> attractors;
+    static inline std::vector<Spring> springs;
+    static inline Gravitation gravitation;
+
+    static inline BarnesHut tree;
+    static inline std::vector<Scalar> body_x, body_y, body_mass;
+    static inline std::vector<Scalar> object_ax, object_ay;     // interactions of ball objects
+    static inline std::unique_ptr<ThreadPool> pool;
+    static const size_t BODIES_PER_TASK = 1024;
+
+    static ThreadPool& threadPool() {
+        if (!pool) pool = std::make_unique<ThreadPool>();
+        return *pool;
+    }
+
+    // Gravity on every awake body from all bodies, added to ax and ay. Bodies are visited in
+    // tree order, each task then works on one region of space.
+    static void gravitate(const std::vector<uint8_t>& asleep, std::vector<Scalar>& ax, std::vector<Scalar>& ay) {
+        const size_t count = body_x.size();
+        tree.build(body_x.data(), body_y.data(), body_mass.data(), count);
+
+        const size_t tasks = (count + BODIES_PER_TASK - 1) / BODIES_PER_TASK;
+        auto task = [&](size_t t) {
+            const size_t last = std::min(count, (t + 1) * BODIES_PER_TASK);
+            for (size_t k{t * BODIES_PER_TASK}; k < last; ++k) {
+                const uint32_t i = tree.getBody(k);
+                if (!asleep.empty() && asleep[i]) continue;
+                const Vec2 a = tree.acceleration(i, body_x[i], body_y[i],
+                                                         gravitation.theta, gravitation.softening);
+                ax[i] += gravitation.constant * a.x;
+                ay[i] += gravitation.constant * a.y;
+            }
+        };
+        if (tasks > 1) {
+            threadPool().parallelFor(tasks, task);
+        } else {
+            for (size_t t{0}; t < tasks; ++t) task(t);
+        }
+    }
+
+    template <typename T>
+    static void stretch(ParticleStore<T>& balls, const Spring& spring) {
+        if (!balls.isAlive(spring.a) || !balls.isAlive(spring.b)) return;
+        const size_t i = balls.indexOf(spring.a), j = balls.indexOf(spring.b);
+
+        const Vec2 delta = balls.getPosition(j) - balls.getPosition(i);
+        const Scalar dist = utils::norm2f(delta);
+        if (dist < EPSILON) return;
+        const Vec2 normal = delta / dist;
+        const Scalar speed = utils::dot(balls.getVelocity(j) - balls.getVelocity(i), normal);
+        const Scalar pull  = spring.stiffness * (dist - spring.rest_length) + spring.damping * speed;
+
+        // Equal and opposite forces, the lighter ball accelerates more
+        const Scalar massA = balls.radius[i] * balls.radius[i], massB = balls.radius[j] * balls.radius[j];
+        const Scalar shareA = 2.f * massB / (massA + massB), shareB = 2.f * massA / (massA + massB);
+        balls.ax[i] += pull * shareA * normal.x;    balls.ay[i] += pull * shareA * normal.y;
+        balls.ax[j] -= pull * shareB * normal.x;    balls.ay[j] -= pull * shareB * normal.y;
+    }
+
+public:
+    // Acceleration from the local fields
+    [[nodiscard]] static Vec2 at(Vec2 position, Vec2 velocity) {
+        Vec2 acceleration = uniform;
+        if (drag > 0.f) acceleration -= drag * velocity;
+        for (const Attractor& attractor : attractors) {
+            const Vec2 delta = attractor.center - position;
+            const Scalar d2 = utils::dot(delta, delta) + attractor.softening * attractor.softening;
+            acceleration += delta * (attractor.strength / (d2 * utils::sqrt(d2)));
+        }
+        return acceleration;
+    }
+
+    // How at() changes with the position, for implicit integrators. Uniform gravity and drag do not
+    // depend on it, an attractor pulls strength (|d|² + s²)^-3/2 (3 d dᵀ / (|d|² + s²) - I) per pixel.
+    [[nodiscard]] static FieldGradient gradient(Vec2 position) {
+        FieldGradient gradient;
+        for (const Attractor& attractor : attractors) {
+            const Vec2 delta = attractor.center - position;
+            const Scalar d2 = utils::dot(delta, delta) + attractor.softening * attractor.softening;
+            const Scalar scale = attractor.strength / (d2 * utils::sqrt(d2));
+            const Scalar stretch = Scalar(3) * scale / d2;
+            gradient.xx += stretch * delta.x * delta.x - scale;
+            gradient.xy += stretch * delta.x * delta.y;
+            gradient.yy += stretch * delta.y * delta.y - scale;
+        }
+        return gradient;
+    }
+
+    // Interactions of a store, once per step before updatePositions. Leaves ax and ay empty
+    // when there are none, integrators then skip them.
+    template <typename T>
+    static void accumulate(ParticleStore<T>& balls) {
+        if (!hasInteractions()) {
+            balls.ax.clear();
+            balls.ay.clear();
+            return;
+        }
+        balls.ax.assign(balls.size(), 0.f);
+        balls.ay.assign(balls.size(), 0.f);
+
+        for (const Spring& spring : springs) stretch(balls, spring);
+
+        if (gravitation.enabled) {
+            body_x.assign(balls.x.begin(), balls.x.end());
+            body_y.assign(balls.y.begin(), balls.y.end());
+            body_mass.resize(balls.size());
+            for (size_t i{0}; i < balls.size(); ++i) body_mass[i] = balls.radius[i] * balls.radius[i];
+            gravitate(balls.asleep, balls.ax, balls.ay);
+        }
+    }
+
+    // Ball objects keep the whole acceleration of the step in Ball::acceleration.
+    // Springs name balls by ParticleHandle and only act on a ParticleStore.
+    template <typename T>
+    static void accumulate(std::vector<T>& balls) {
+        object_ax.assign(balls.size(), 0.f);
+        object_ay.assign(balls.size(), 0.f);
+        if (gravitation.enabled) {
+            body_x.resize(balls.size());
+            body_y.resize(balls.size());
+            body_mass.resize(balls.size());
+            for (size_t i{0}; i < balls.size(); ++i) {
+                body_x[i]    = balls[i].getPosition().x;
+                body_y[i]    = balls[i].getPosition().y;
+                body_mass[i] = balls[i].radius * balls[i].radius;
+            }
+            gravitate({}, object_ax, object_ay);
+        }
+        for (size_t i{0}; i < balls.size(); ++i) {
+            balls[i].acceleration = at(balls[i].getPosition(), balls[i].getVelocity()) + Vec2{object_ax[i], object_ay[i]};
+        }
+    }
+
+    // Uniform acceleration in pixels/s², gravity by default
+    static void setUniform(Vec2 acceleration) { uniform = acceleration;}
+    // Velocity damping in 1/s, 0 = none
+    static void setDrag(Scalar coefficient) { drag = coefficient;}
+    static void addAttractor(const Attractor& attractor) { attractors.push_back(attractor);}
+    static void addSpring(const Spring& spring) { springs.push_back(spring);}
+    // theta is clamped to [0, BarnesHut::MAX_THETA]
+    static void setGravitation(const Gravitation& settings) {
+        gravitation = settings;
+        gravitation.theta = std::clamp(settings.theta, Scalar(0.f), Scalar(BarnesHut::MAX_THETA));
+    }
+
+    // Back to plain gravity
+    static void reset() {
+        uniform = ACCELERATION;
+        drag    = 0.f;
+        attractors.clear();
+        springs.clear();
+        gravitation = {};
+    }
+
+    // Number of threads evaluating mutual gravity, defaults to the core count
+    static void setThreadCount(size_t thread_count) { pool = std::make_unique<ThreadPool>(thread_count);}
+
+    [[nodiscard]] static Vec2 getUniform() { return uniform;}
+    [[nodiscard]] static Scalar getDrag() { return drag;}
+    [[nodiscard]] static const std::vector<Attractor>& getAttractors() { return attractors;}
+    [[nodiscard]] static const std::vector<Spring>& getSprings() { return springs;}
+    [[nodiscard]] static const Gravitation& getGravitation() { return gravitation;}
+    [[nodiscard]] static size_t getTreeNodeCount() { return tree.getNodeCount();}
+
+    // Only uniform acceleration, the same for every ball (vectorized Verlet path)
+    [[nodiscard]] static bool isUniform() { return drag == 0.f && attractors.empty();}
+    [[nodiscard]] static bool hasInteractions() { return !springs.empty() || gravitation.enabled;}
+};
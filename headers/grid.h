@@ -0,0 +1,134 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Uniform grid broadphase
+// Every cell is at least one ball diameter wide, so a ball can only overlap balls
+// in its own cell or in one of the 8 surrounding cells.
+class UniformGrid {
+private:
+    float cell_size = 1.f;
+    int columns = 0;
+    int rows    = 0;
+    std::vector<uint32_t> cell_start;   // cell c owns cell_items[cell_start[c], cell_start[c + 1])
+    std::vector<uint32_t> cell_items;   // ball indices, grouped by cell
+    std::vector<uint32_t> ball_cell;    // cell index of every ball
+    std::vector<uint32_t> cursor;       // insertion cursor per cell while building
+
+    [[nodiscard]] int toCell(float coordinate, int count) const
+    {
+        int cell = static_cast<int>(std::floor(coordinate / cell_size));
+        return std::clamp(cell, 0, count - 1);
+    }
+
+    template <typename PairFn>
+    void collideCells(uint32_t cellA, uint32_t cellB, PairFn& pair) const
+    {
+        for (uint32_t a{cell_start[cellA]}; a < cell_start[cellA + 1]; ++a) {
+            for (uint32_t b{cell_start[cellB]}; b < cell_start[cellB + 1]; ++b) {
+                pair(cell_items[a], cell_items[b]);
+            }
+        }
+    }
+
+public:
+    // Room for count balls, so that builds up to that many do not allocate
+    void reserve(size_t count)
+    {
+        ball_cell.reserve(count);
+        cell_items.reserve(count);
+    }
+
+    // Bucket balls into cells with a counting sort, position(i) returns the centre of ball i.
+    // Cells are found in float whatever the Scalar of the positions.
+    template <typename PositionFn>
+    void build(size_t count, float world_width, float world_height, float max_radius, PositionFn position)
+    {
+        cell_size = std::max(2.f * max_radius, 1.f);
+        columns   = std::max(1, static_cast<int>(std::ceil(world_width / cell_size)));
+        rows      = std::max(1, static_cast<int>(std::ceil(world_height / cell_size)));
+
+        const size_t cell_count = static_cast<size_t>(columns) * rows;
+        cell_start.assign(cell_count + 1, 0);
+        ball_cell.resize(count);
+        cell_items.resize(count);
+
+        for (size_t i{0}; i < count; ++i) {
+            const auto p = position(i);
+            const uint32_t cell = static_cast<uint32_t>(toCell(static_cast<float>(p.y), rows) * columns
+                                                      + toCell(static_cast<float>(p.x), columns));
+            ball_cell[i] = cell;
+            ++cell_start[cell + 1];
+        }
+
+        for (size_t c{0}; c < cell_count; ++c) {
+            cell_start[c + 1] += cell_start[c];
+        }
+
+        cursor.assign(cell_start.begin(), cell_start.end() - 1);
+        for (size_t i{0}; i < count; ++i) {
+            cell_items[cursor[ball_cell[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Visit every candidate pair in the columns [first_column, last_column) exactly once.
+    // Pairs reach at most one column to the left and one to the right of that range.
+    template <typename PairFn>
+    void forEachPairInColumns(int first_column, int last_column, PairFn&& pair) const
+    {
+        for (int y{0}; y < rows; ++y) {
+            for (int x{first_column}; x < last_column; ++x) {
+                const uint32_t cell = static_cast<uint32_t>(y * columns + x);
+
+                // Pairs inside the cell
+                for (uint32_t a{cell_start[cell]}; a < cell_start[cell + 1]; ++a) {
+                    for (uint32_t b{a + 1}; b < cell_start[cell + 1]; ++b) {
+                        pair(cell_items[a], cell_items[b]);
+                    }
+                }
+
+                // Half of the neighbourhood (E, SW, S, SE) so each cell pair is visited once
+                if (x + 1 < columns) collideCells(cell, cell + 1, pair);
+                if (y + 1 < rows) {
+                    const uint32_t below = cell + columns;
+                    if (x > 0) collideCells(cell, below - 1, pair);
+                    collideCells(cell, below, pair);
+                    if (x + 1 < columns) collideCells(cell, below + 1, pair);
+                }
+            }
+        }
+    }
+
+    template <typename PairFn>
+    void forEachPair(PairFn&& pair) const
+    {
+        forEachPairInColumns(0, columns, pair);
+    }
+
+    // Visit every ball whose cell overlaps the box [min_x, max_x] x [min_y, max_y]
+    template <typename BallFn>
+    void forEachInBox(float min_x, float min_y, float max_x, float max_y, BallFn&& fn) const
+    {
+        const int first_x = toCell(min_x, columns), last_x = toCell(max_x, columns);
+        const int first_y = toCell(min_y, rows),    last_y = toCell(max_y, rows);
+        for (int y{first_y}; y <= last_y; ++y) {
+            for (int x{first_x}; x <= last_x; ++x) {
+                const uint32_t cell = static_cast<uint32_t>(y * columns + x);
+                for (uint32_t a{cell_start[cell]}; a < cell_start[cell + 1]; ++a) fn(cell_items[a]);
+            }
+        }
+    }
+
+    // Visit every ball, grouped by cell
+    template <typename BallFn>
+    void forEachInCellOrder(BallFn&& fn) const
+    {
+        for (const uint32_t item : cell_items) fn(item);
+    }
+
+    [[nodiscard]] float getCellSize() const { return cell_size;}
+    [[nodiscard]] int getColumns() const { return columns;}
+    [[nodiscard]] int getRows() const { return rows;}
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "grid.h"
+
+// Hierarchical grid broadphase for widely varying radii
+// Level k has cells 2^k times as wide as level 0, the coarsest fits the largest ball. Every ball
+// goes to the finest level whose cells are at least its diameter, is paired with the balls of its
+// own level through that level's uniform grid, and looks up the balls of the coarser levels around
+// it. Dust never shares a cell with a boulder, so the cost stays close to linear whatever the
+// spread of radii, where a single grid sized for the largest ball degrades towards O(n^2).
+class HierarchicalGrid {
+private:
+    static constexpr int MAX_LEVELS = 16;
+
+    struct Level {
+        UniformGrid grid;
+        std::vector<uint32_t> balls;    // ball index of every item of the grid
+        float max_radius = 0.f;         // half the cell size
+    };
+
+    struct Point {
+        float x, y;
+    };
+
+    std::vector<Level> levels;          // kept between steps, so a steady scene does not allocate
+    int level_count = 0;
+    std::vector<float> ball_x, ball_y, ball_radius;
+
+public:
+    // Sort the balls into levels and bucket each level, position(i) and radius(i) describe ball i
+    template <typename PositionFn, typename RadiusFn>
+    void build(size_t count, float world_width, float world_height, PositionFn position, RadiusFn radius)
+    {
+        ball_x.resize(count);
+        ball_y.resize(count);
+        ball_radius.resize(count);
+        float min_radius = count > 0 ? INFINITY : 0.f, max_radius = 0.f;
+        for (size_t i{0}; i < count; ++i) {
+            const auto p = position(i);
+            ball_x[i]      = static_cast<float>(p.x);
+            ball_y[i]      = static_cast<float>(p.y);
+            ball_radius[i] = static_cast<float>(radius(i));
+            min_radius = std::min(min_radius, ball_radius[i]);
+            max_radius = std::max(max_radius, ball_radius[i]);
+        }
+
+        // Halve the cells from the largest ball down until they would no longer fit the smallest one
+        const float floor_radius = std::max(min_radius, 0.5f);
+        level_count = 1;
+        while (level_count < MAX_LEVELS && std::ldexp(max_radius, -level_count) >= floor_radius) ++level_count;
+        if (levels.size() < static_cast<size_t>(level_count)) levels.resize(level_count);
+        for (int k{0}; k < level_count; ++k) {
+            levels[k].balls.clear();
+            levels[k].max_radius = std::ldexp(max_radius, k - (level_count - 1));
+        }
+
+        for (size_t i{0}; i < count; ++i) {
+            int k = 0;
+            while (k + 1 < level_count && levels[k].max_radius < ball_radius[i]) ++k;
+            levels[k].balls.push_back(static_cast<uint32_t>(i));
+        }
+
+        for (int k{0}; k < level_count; ++k) {
+            Level& level = levels[k];
+            if (level.balls.empty()) continue;
+            // A sparse level gets cells wider than its balls, at most about 4 per ball, so scanning
+            // empty cells stays proportional to the balls
+            const float sparse = 0.25f * std::sqrt(world_width * world_height / static_cast<float>(level.balls.size()));
+            const float cell_radius = std::max(level.max_radius, sparse);
+            level.grid.build(level.balls.size(), world_width, world_height, cell_radius, [&](size_t item) {
+                const uint32_t i = level.balls[item];
+                return Point{ball_x[i], ball_y[i]};
+            });
+        }
+    }
+
+    // Visit every candidate pair once: the pairs of each level, then each ball against the coarser levels
+    template <typename PairFn>
+    void forEachPair(PairFn&& pair) const
+    {
+        for (int k{0}; k < level_count; ++k) {
+            const Level& level = levels[k];
+            if (level.balls.empty()) continue;
+            level.grid.forEachPair([&](uint32_t a, uint32_t b) { pair(level.balls[a], level.balls[b]); });
+        }
+
+        // Fine balls are taken in cell order, so neighbouring queries hit the same coarse cells
+        for (int k{0}; k + 1 < level_count; ++k) {
+            const Level& fine = levels[k];
+            if (fine.balls.empty()) continue;
+            fine.grid.forEachInCellOrder([&](uint32_t fine_item) {
+                const uint32_t i = fine.balls[fine_item];
+                const float x = ball_x[i], y = ball_y[i];
+                for (int c{k + 1}; c < level_count; ++c) {
+                    const Level& coarse = levels[c];
+                    if (coarse.balls.empty()) continue;
+                    // A touching ball of that level has its centre within both radii
+                    const float reach = ball_radius[i] + coarse.max_radius;
+                    coarse.grid.forEachInBox(x - reach, y - reach, x + reach, y + reach,
+                                             [&](uint32_t item) { pair(i, coarse.balls[item]); });
+                }
+            });
+        }
+    }
+
+    [[nodiscard]] int getLevelCount() const { return level_count;}
+    [[nodiscard]] size_t getLevelSize(int k) const { return levels[k].balls.size();}
+};
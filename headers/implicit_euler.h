@@ -1,39 +1,178 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include "ball.h"
+#include "particles.h"
+#include "forces.h"
+#include "explicit_euler.h"
+
+// Backward (implicit) Euler: the step takes the acceleration at its end,
+//   v' = v + a(x', v') dt
+//   x' = x + v' dt
+// Drag is linear in the velocity and solved exactly, so any drag * dt is stable. The attractors are
+// solved by Newton iteration on x' with Forces::gradient, until the residual is under
+// settings.tolerance. Where the field changes too much within a step for that to converge (close
+// to an attractor at large dt), the step is not a backward Euler step, see unconverged. It damps
+// motion that should keep its energy. Under uniform gravity alone it gives the same steps as EulerBall.
+namespace backward_euler {
+
+struct Settings {
+    Scalar tolerance        = 1e-3f;    // pixels, |x' - x - v' dt| Newton stops at
+    uint32_t max_iterations = 50;       // per step, the step is then taken from where Newton got to
+};
+inline Settings settings;
+// Steps whose Newton iteration ended above the tolerance, counted from every thread
+inline std::atomic<uint64_t> unconverged{0};
+
+// interaction is the acceleration from other balls (Forces::accumulate), held over the step
+inline void advance(Vec2& position, Vec2& velocity, Scalar dt, Vec2 interaction = {})
+{
+    // a(x, v) = a(x, 0) - drag v, so v' = (v + (a(x', 0) + interaction) dt) / (1 + drag dt)
+    const Scalar damping = Scalar(1) / (Scalar(1) + Forces::getDrag() * dt);
+    auto velocityAt = [&](Vec2 next) { return (velocity + (Forces::at(next, {}) + interaction) * dt) * damping;};
+
+    // Root of r(x') = x' - x - v'(x') dt, whose derivative is I - dt² damping ∂a/∂x
+    Vec2 next = position + velocity * dt;
+    if (!Forces::getAttractors().empty()) {
+        auto residualAt = [&](Vec2 at) { return at - position - velocityAt(at) * dt;};
+        const Scalar h = dt * dt * damping;
+        Scalar error = utils::norm2f(residualAt(next));
+        for (uint32_t n{0}; n < settings.max_iterations && error > settings.tolerance; ++n) {
+            const Vec2 residual = residualAt(next);
+            const FieldGradient g = Forces::gradient(next);
+            const Scalar xx = Scalar(1) - h * g.xx, xy = -h * g.xy, yy = Scalar(1) - h * g.yy;
+            const Scalar determinant = xx * yy - xy * xy;
+            if (utils::abs(determinant) < EPSILON) break;
+            const Vec2 delta = Vec2{yy * residual.x - xy * residual.y, xx * residual.y - xy * residual.x} / determinant;
+
+            // Far from the root the full step can overshoot, it is halved until the residual shrinks
+            Vec2 trial = next - delta;
+            Scalar trial_error = utils::norm2f(residualAt(trial));
+            for (Scalar fraction{0.5f}; trial_error >= error && fraction > Scalar(1.f / 256); fraction *= Scalar(0.5f)) {
+                trial = next - delta * fraction;
+                trial_error = utils::norm2f(residualAt(trial));
+            }
+            if (trial_error >= error) break;
+            next  = trial;
+            error = trial_error;
+        }
+        if (error > settings.tolerance) unconverged.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    velocity = velocityAt(next);
+    position += velocity * dt;
+}
+
+}
 
 class ImplicitEulerBall : public Ball {
-private:
-    const float gravity = acceleration.y; // Constant gravitational acceleration in pixels/s²
 public:
-    using Ball::Ball;
-
-    void updatePosition(const int& windowWidth, const int& windowHeight) override {
-        // Implicitly update velocity
-        sf::Vector2f velocityNext = velocity + acceleration * deltaTime;
-
-        // Update position using the new velocity
-        sf::Vector2f position = getPosition();
-        sf::Vector2f newPosition = position + velocityNext * deltaTime;
-
-        if (newPosition.x + radius >= windowWidth) {
-            velocityNext.x *= - RESTITUTION;
-            newPosition.x = windowWidth - radius;
-        } else if (newPosition.x - radius <= 0) {
-            velocityNext.x *= - RESTITUTION;
-            newPosition.x = radius;
+    ImplicitEulerBall(Scalar radius, Vec2 init_position, Scalar init_speed, Scalar angle)
+        : Ball(radius, init_position, init_speed, angle)
+    {}
+
+    void updatePosition()
+    {
+        // Forces::accumulate leaves the local fields plus the interactions in acceleration
+        const Vec2 interaction = acceleration - Forces::at(position, velocity);
+        backward_euler::advance(position, velocity, deltaTime, interaction);
+        setShapePosition(position);
+    }
+
+    [[nodiscard]] Vec2 getPosition() const
+    {
+        return position;
+    }
+
+    [[nodiscard]] Vec2 getVelocity() const
+    {
+        return velocity;
+    }
+
+    [[nodiscard]] Scalar getSpeed() const noexcept
+    {
+        return utils::norm2f(velocity);
+    }
+
+    friend class CollisionSolver<ImplicitEulerBall>;
+};
+
+
+template<>
+inline void ParticleStore<ImplicitEulerBall>::updatePositions(size_t first, size_t last)
+{
+    const bool interacting = hasInteractions();
+    for (size_t i{first}; i < last; ++i) {
+        if (asleep[i]) continue;
+        Vec2 position{x[i], y[i]}, velocity{vx[i], vy[i]};
+        const Vec2 interaction = interacting ? Vec2{ax[i], ay[i]} : Vec2{};
+        backward_euler::advance(position, velocity, deltaTime, interaction);
+        x[i]  = position.x;     y[i]  = position.y;
+        vx[i] = velocity.x;     vy[i] = velocity.y;
+    }
+}
+
+
+// Same impulses as EulerBall, only the integration differs
+template<>
+class CollisionSolver<ImplicitEulerBall> {
+    CollisionSolver() = default;
+    using EulerCollisions = CollisionSolver<EulerBall>;
+
+public:
+    static void handleBorderCollision(ImplicitEulerBall& ball, const int windowWidth, const int windowHeight)
+    {
+        EulerCollisions::bounceOffBorder(ball.position, ball.velocity, ball.radius, windowWidth, windowHeight);
+        ball.setShapePosition(ball.position);
+    }
+
+    static bool resolvePairCollision(ImplicitEulerBall& ballA, ImplicitEulerBall& ballB)
+    {
+        if (EulerCollisions::collide(ballA.position, ballB.position, ballA.velocity, ballB.velocity,
+                                     ballA.radius, ballB.radius)) {
+            ballA.setShapePosition(ballA.position);
+            ballB.setShapePosition(ballB.position);
+            return true;
         }
+        return false;
+    }
 
-        if (newPosition.y + radius >= windowHeight) {
-            velocityNext.y *= - RESTITUTION;
-            velocityNext.x *= FRICTION_COEFFICIENT;
-            newPosition.y = windowHeight - radius;
-        } else if (newPosition.y - radius <= 0) {
-            velocityNext.y *= - RESTITUTION;
-            newPosition.y = radius;
+    static void resolveWallCollision(ImplicitEulerBall& ball, const Wall& wall)
+    {
+        if (EulerCollisions::bounceOffWall(ball.position, ball.velocity, ball.radius, wall)) {
+            ball.setShapePosition(ball.position);
         }
+    }
+
+    // Structure-of-arrays versions, i and j index into the store
+    static void handleBorderCollision(ParticleStore<ImplicitEulerBall>& balls, size_t i, const int windowWidth, const int windowHeight)
+    {
+        Vec2 position{balls.x[i], balls.y[i]};
+        Vec2 velocity{balls.vx[i], balls.vy[i]};
+        EulerCollisions::bounceOffBorder(position, velocity, balls.radius[i], windowWidth, windowHeight);
+        balls.x[i] = position.x;     balls.y[i] = position.y;
+        balls.vx[i] = velocity.x;    balls.vy[i] = velocity.y;
+    }
 
-        // Step 4: Set the position and velocity
-        circleObject.setPosition(newPosition);
-        velocity = velocityNext; // Update velocity to the new velocity
+    static bool resolvePairCollision(ParticleStore<ImplicitEulerBall>& balls, size_t i, size_t j)
+    {
+        Vec2 posA{balls.x[i], balls.y[i]},   posB{balls.x[j], balls.y[j]};
+        Vec2 velA{balls.vx[i], balls.vy[i]}, velB{balls.vx[j], balls.vy[j]};
+        if (EulerCollisions::collide(posA, posB, velA, velB, balls.radius[i], balls.radius[j])) {
+            balls.x[i] = posA.x;     balls.y[i] = posA.y;     balls.x[j] = posB.x;     balls.y[j] = posB.y;
+            balls.vx[i] = velA.x;    balls.vy[i] = velA.y;    balls.vx[j] = velB.x;    balls.vy[j] = velB.y;
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(ParticleStore<ImplicitEulerBall>& balls, size_t i, const Wall& wall)
+    {
+        Vec2 position{balls.x[i], balls.y[i]};
+        Vec2 velocity{balls.vx[i], balls.vy[i]};
+        if (EulerCollisions::bounceOffWall(position, velocity, balls.radius[i], wall)) {
+            balls.x[i] = position.x;     balls.y[i] = position.y;
+            balls.vx[i] = velocity.x;    balls.vy[i] = velocity.y;
+        }
     }
 };
@@ -0,0 +1,356 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "thread_pool.h"
+
+// Phases of a frame and the order between them, run by a JobSystem.
+// A phase is split into chunks when it becomes ready: chunks() is asked only once every phase
+// before it finished, so a phase can size itself by what those produced (balls spawned, grid
+// columns). task(k) runs chunk k, the chunks of a phase may run at the same time on different
+// threads. A graph is built once and run every frame.
+class TaskGraph {
+public:
+    using Phase   = uint32_t;
+    using ChunkFn = std::function<size_t()>;
+    using TaskFn  = std::function<void(size_t chunk)>;
+
+    // Phase starting once every phase of after finished
+    Phase add(const char* name, ChunkFn chunks, TaskFn task, std::initializer_list<Phase> after = {})
+    {
+        const Phase phase = static_cast<Phase>(nodes.size());
+        nodes.push_back({name, std::move(chunks), std::move(task), {}, 0});
+        for (const Phase before : after) precede(before, phase);
+        return phase;
+    }
+
+    void precede(Phase before, Phase after)
+    {
+        nodes[before].successors.push_back(after);
+        ++nodes[after].predecessors;
+    }
+
+    [[nodiscard]] size_t size() const { return nodes.size();}
+    [[nodiscard]] const char* getName(Phase phase) const { return nodes[phase].name;}
+
+private:
+    friend class JobSystem;
+
+    struct Node {
+        const char* name;
+        ChunkFn chunks;
+        TaskFn task;
+        std::vector<Phase> successors;
+        uint32_t predecessors;
+    };
+    std::vector<Node> nodes;
+};
+
+// Work-stealing scheduler for TaskGraph.
+// Every thread owns a deque of chunks. It takes its own from the back, the newest first, while
+// what they touch is still in its cache; a thread that ran dry steals from the front of another
+// thread's deque, the oldest chunks. A finished phase pushes the chunks of the phases it released
+// onto the deque of the thread that finished it, so a phase boundary is not a barrier for the
+// threads that are still busy. Threads are started once and sleep between runs. The calling
+// thread works too, so a system of size n runs n - 1 extra threads (as ThreadPool). Deques only
+// grow, a graph of the same shape runs without allocating.
+// While a graph runs, ThreadPool::parallelFor called from its tasks (the Solver and Forces pools)
+// is forked onto these deques: the calling thread pushes the items, works on them and on anything
+// else ready until they are done, and the other threads steal them like any chunk.
+class JobSystem {
+public:
+    // What one thread did since the last resetStats
+    struct WorkerStats {
+        double busy_ms  = 0.0;      // running tasks
+        uint64_t tasks  = 0;
+        uint64_t steals = 0;        // tasks taken from the deque of another thread
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Items of one parallelFor forked from a task
+    struct Fork {
+        const void* job;
+        ParallelInvoke invoke;
+        std::atomic<size_t> remaining;
+    };
+
+    struct Task {
+        TaskGraph::Phase phase;
+        uint32_t chunk;
+        Fork* fork;         // item chunk of fork if set, else chunk of phase
+    };
+
+    // What parallel_for_delegate calls back with, the thread forking
+    struct ForkContext {
+        JobSystem* jobs;
+        size_t self;
+    };
+
+    // Apart on their own cache lines, every thread pushes to and pops from its own all the time
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::vector<Task> ring{64};     // power of two sized
+        size_t head = 0;                // front, counted up without wrapping
+        size_t tail = 0;                // one past the back
+        WorkerStats stats;
+    };
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Worker[]> workers;
+    size_t worker_count = 1;
+
+    std::mutex mutex;
+    std::condition_variable wake_threads;
+    std::condition_variable run_finished;
+    uint64_t generation  = 0;
+    size_t busy_threads  = 0;
+    bool stopping        = false;
+
+    // State of the current run
+    const TaskGraph* graph = nullptr;
+    std::unique_ptr<std::atomic<uint32_t>[]> waiting;   // unfinished predecessors of each phase
+    std::unique_ptr<std::atomic<size_t>[]> remaining;   // unfinished chunks of each released phase
+    size_t phase_capacity = 0;
+    std::atomic<size_t> phases_left{0};
+
+    double run_ms = 0.0;
+    uint64_t runs = 0;
+
+    void push(Worker& worker, Task task)
+    {
+        if (worker.tail - worker.head == worker.ring.size()) {
+            std::vector<Task> grown(2 * worker.ring.size());
+            for (size_t k{worker.head}; k < worker.tail; ++k) grown[k - worker.head] = worker.ring[k & (worker.ring.size() - 1)];
+            worker.tail -= worker.head;
+            worker.head  = 0;
+            worker.ring.swap(grown);
+        }
+        worker.ring[worker.tail++ & (worker.ring.size() - 1)] = task;
+    }
+
+    bool pop(size_t self, Task& task)
+    {
+        Worker& worker = workers[self];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tail == worker.head) return false;
+        task = worker.ring[--worker.tail & (worker.ring.size() - 1)];
+        return true;
+    }
+
+    bool steal(size_t self, Task& task)
+    {
+        for (size_t offset{1}; offset < worker_count; ++offset) {
+            Worker& victim = workers[(self + offset) % worker_count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tail == victim.head) continue;
+            task = victim.ring[victim.head++ & (victim.ring.size() - 1)];
+            ++workers[self].stats.steals;
+            return true;
+        }
+        return false;
+    }
+
+    // All predecessors of phase finished, hand out its chunks
+    void release(size_t self, TaskGraph::Phase phase)
+    {
+        const size_t chunks = graph->nodes[phase].chunks();
+        if (chunks == 0) {
+            finish(self, phase);
+            return;
+        }
+        remaining[phase].store(chunks, std::memory_order_relaxed);
+
+        // Last chunk first, the owner pops them in order and thieves take the far end
+        Worker& worker = workers[self];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        for (size_t k{chunks}; k-- > 0;) push(worker, {phase, static_cast<uint32_t>(k), nullptr});
+    }
+
+    // The successors are released before the phase counts as done, so a run cannot end in between
+    void finish(size_t self, TaskGraph::Phase phase)
+    {
+        for (const TaskGraph::Phase next : graph->nodes[phase].successors) {
+            if (waiting[next].fetch_sub(1, std::memory_order_acq_rel) == 1) release(self, next);
+        }
+        phases_left.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void execute(size_t self, Task task)
+    {
+        const Clock::time_point start = Clock::now();
+        if (task.fork) task.fork->invoke(task.fork->job, task.chunk);
+        else graph->nodes[task.phase].task(task.chunk);
+        WorkerStats& stats = workers[self].stats;
+        stats.busy_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        ++stats.tasks;
+
+        if (task.fork) task.fork->remaining.fetch_sub(1, std::memory_order_acq_rel);
+        else if (remaining[task.phase].fetch_sub(1, std::memory_order_acq_rel) == 1) finish(self, task.phase);
+    }
+
+    // parallelFor from inside a task on thread self. The items run as tasks of their own and count
+    // their own busy time, so the time spent here is taken off the task that forked.
+    void forkJoin(size_t self, size_t count, const void* job, ParallelInvoke invoke)
+    {
+        const Clock::time_point start = Clock::now();
+        Fork fork{job, invoke, {count}};
+        {
+            Worker& worker = workers[self];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            for (size_t k{count}; k-- > 0;) push(worker, {0, static_cast<uint32_t>(k), &fork});
+        }
+
+        // Other threads may still be running items of fork, and this one anything ready meanwhile
+        Task task;
+        while (fork.remaining.load(std::memory_order_acquire) > 0) {
+            if (pop(self, task) || steal(self, task)) execute(self, task);
+            else std::this_thread::yield();
+        }
+        workers[self].stats.busy_ms -= std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void work(size_t self)
+    {
+        ForkContext context{this, self};
+        const ParallelForDelegate outer = parallel_for_delegate;
+        parallel_for_delegate = {&context, [](void* fork_context, size_t count, const void* job, ParallelInvoke invoke) {
+            const ForkContext& on = *static_cast<ForkContext*>(fork_context);
+            on.jobs->forkJoin(on.self, count, job, invoke);
+        }};
+
+        Task task;
+        while (phases_left.load(std::memory_order_acquire) > 0) {
+            if (pop(self, task) || steal(self, task)) execute(self, task);
+            else std::this_thread::yield();
+        }
+        parallel_for_delegate = outer;
+    }
+
+    void threadLoop(size_t self)
+    {
+        uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake_threads.wait(lock, [&] { return stopping || generation != seen_generation; });
+                if (stopping) return;
+                seen_generation = generation;
+            }
+
+            work(self);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy_threads == 0) run_finished.notify_one();
+        }
+    }
+
+public:
+    explicit JobSystem(size_t thread_count = std::thread::hardware_concurrency())
+    {
+        worker_count = std::max<size_t>(thread_count, 1);
+        workers = std::make_unique<Worker[]>(worker_count);
+        for (size_t i{1}; i < worker_count; ++i) {
+            threads.emplace_back([this, i] { threadLoop(i); });
+        }
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake_threads.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    [[nodiscard]] size_t size() const { return worker_count;}
+
+    // Run every phase of tasks once, in dependency order, and wait until the last one finished
+    void run(const TaskGraph& tasks)
+    {
+        const size_t phase_count = tasks.size();
+        if (phase_count == 0) return;
+        const Clock::time_point start = Clock::now();
+
+        if (phase_capacity < phase_count) {
+            waiting   = std::make_unique<std::atomic<uint32_t>[]>(phase_count);
+            remaining = std::make_unique<std::atomic<size_t>[]>(phase_count);
+            phase_capacity = phase_count;
+        }
+        graph = &tasks;
+        for (size_t p{0}; p < phase_count; ++p) waiting[p].store(tasks.nodes[p].predecessors, std::memory_order_relaxed);
+        phases_left.store(phase_count, std::memory_order_relaxed);
+
+        // The first phases go to this thread, the others steal from there
+        for (size_t p{0}; p < phase_count; ++p) {
+            if (tasks.nodes[p].predecessors == 0) release(0, static_cast<TaskGraph::Phase>(p));
+        }
+
+        if (!threads.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy_threads = threads.size();
+                ++generation;
+            }
+            wake_threads.notify_all();
+        }
+
+        work(0);
+
+        if (!threads.empty()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            run_finished.wait(lock, [&] { return busy_threads == 0; });
+        }
+        graph = nullptr;
+        run_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        ++runs;
+    }
+
+    // Stats of thread i (0 is the one calling run), only read them between runs
+    [[nodiscard]] const WorkerStats& getWorkerStats(size_t i) const { return workers[i].stats;}
+
+    // Share of the run time thread i spent in tasks. Low numbers on every thread but one mean
+    // chunks too coarse to share out, many steals mean chunks too fine for the work they carry.
+    [[nodiscard]] double getUtilization(size_t i) const { return run_ms > 0.0 ? workers[i].stats.busy_ms / run_ms : 0.0;}
+
+    // Wall time spent in run and the number of runs since the last resetStats
+    [[nodiscard]] double getRunTime() const { return run_ms;}
+    [[nodiscard]] uint64_t getRunCount() const { return runs;}
+
+    void resetStats()
+    {
+        for (size_t i{0}; i < worker_count; ++i) workers[i].stats = {};
+        run_ms = 0.0;
+        runs   = 0;
+    }
+
+    // One line of utilization per thread into buffer, returns the length written
+    size_t format(char* buffer, size_t size) const
+    {
+        size_t written = 0;
+        for (size_t i{0}; i < worker_count && written < size; ++i) {
+            const WorkerStats& stats = workers[i].stats;
+            const int n = std::snprintf(buffer + written, size - written, "worker %-2zu %5.1f%% %8llu tasks %6llu steals\n",
+                                        i, 100.0 * getUtilization(i), static_cast<unsigned long long>(stats.tasks),
+                                        static_cast<unsigned long long>(stats.steals));
+            if (n < 0) break;
+            written += static_cast<size_t>(n);
+        }
+        return std::min(written, size);
+    }
+};
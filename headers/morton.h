@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Order of the balls along a Z curve (Morton code) over the world
+// Interleaving the bits of the quantized x and y gives a key whose sorted order keeps balls
+// that are close in space mostly close in memory, so the grid cells and the pairs the narrowphase
+// touches together share cache lines. Keys are sorted with an LSD radix sort, 8 bits per pass,
+// linear in the ball count and stable. Buffers are kept between sorts.
+class MortonOrder {
+private:
+    std::vector<uint64_t> entries, scratch;     // Morton code in the high half, ball index in the low half
+    std::vector<uint32_t> order;
+
+    // Spread the low 16 bits of v over the even bits
+    static uint32_t spread(uint32_t v)
+    {
+        v &= 0x0000ffffu;
+        v = (v | (v << 8)) & 0x00ff00ffu;
+        v = (v | (v << 4)) & 0x0f0f0f0fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    }
+
+public:
+    // Morton code of a point quantized to 16 bits per axis
+    [[nodiscard]] static uint32_t encode(uint32_t x, uint32_t y) { return spread(x) | (spread(y) << 1);}
+
+    // Sort the balls by the Morton code of their centre, position(i) returns the centre of ball i.
+    // Returns order, where order[k] is the ball that belongs at index k.
+    template <typename PositionFn>
+    const std::vector<uint32_t>& sort(size_t count, float world_width, float world_height, PositionFn position)
+    {
+        entries.resize(count);
+        scratch.resize(count);
+
+        // The histograms of all four digits come out of the same pass over the balls
+        uint32_t counts[4][256] = {};
+        const float scale_x = 65535.f / std::max(world_width, 1.f);
+        const float scale_y = 65535.f / std::max(world_height, 1.f);
+        for (size_t i{0}; i < count; ++i) {
+            const auto p = position(i);
+            const float qx = std::clamp(static_cast<float>(p.x) * scale_x, 0.f, 65535.f);
+            const float qy = std::clamp(static_cast<float>(p.y) * scale_y, 0.f, 65535.f);
+            const uint32_t key = encode(static_cast<uint32_t>(qx), static_cast<uint32_t>(qy));
+            entries[i] = static_cast<uint64_t>(key) << 32 | i;
+            for (int digit{0}; digit < 4; ++digit) ++counts[digit][(key >> (8 * digit)) & 0xffu];
+        }
+
+        for (int digit{0}; digit < 4; ++digit) {
+            uint32_t* offsets = counts[digit];
+            // Every key has the same digit, the pass would not move anything
+            if (std::find(offsets, offsets + 256, static_cast<uint32_t>(count)) != offsets + 256) continue;
+
+            uint32_t sum = 0;
+            for (size_t d{0}; d < 256; ++d) {
+                const uint32_t bucket = offsets[d];
+                offsets[d] = sum;
+                sum += bucket;
+            }
+            const int shift = 32 + 8 * digit;
+            for (const uint64_t entry : entries) scratch[offsets[(entry >> shift) & 0xffu]++] = entry;
+            entries.swap(scratch);
+        }
+
+        order.resize(count);
+        for (size_t k{0}; k < count; ++k) order[k] = static_cast<uint32_t>(entries[k]);
+        return order;
+    }
+};
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "ball.h"
+#include "scalar.h"
+
+class VerletBall;
+class RK45Ball;
+
+// Names a ball across swaps and removals, unlike its index in the store.
+// A handle whose ball was erased stops matching (its slot's generation moved on).
+struct ParticleHandle {
+    uint32_t slot       = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Structure-of-arrays storage for many balls integrated the same way as T
+// (VerletBall, EulerBall, ImplicitEulerBall, RK4Ball or RK45Ball). Only the raw state
+// is kept per particle, the SFML shape is built when drawing.
+// Balls are kept packed: erasing one moves the last ball into its index, so indices
+// change but handles stay valid. Spawning and erasing are O(1) and do not allocate
+// once reserve covers the peak ball count.
+template <typename T>
+class ParticleStore {
+private:
+    Scalar deltaTime = Scalar(1) / Scalar(120);
+
+    // Sleeping, off by default
+    bool sleep_enabled     = false;
+    Scalar sleep_threshold = 2.f;       // drift in pixels that keeps a ball awake
+    uint16_t sleep_steps   = 15;        // steps within the threshold before a ball sleeps
+    Scalar wake_threshold  = 4.f;       // pixels per step an awake ball needs to wake a sleeping one it hits
+    size_t sleeping        = 0;         // asleep balls as of the last updateSleep
+
+    // Handle slots, freed slots are reused through a list threaded through slot_index
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    std::vector<uint32_t> slot_index;       // index of the slot's ball, next free slot while free
+    std::vector<uint32_t> slot_generation;  // bumped every time the slot's ball is erased
+    std::vector<uint32_t> owner;            // slot of each ball
+    uint32_t free_slot = NO_SLOT;
+
+    template <typename Value>
+    static void moveLast(std::vector<Value>& values, size_t i)
+    {
+        if (values.empty()) return;
+        values[i] = values.back();
+        values.pop_back();
+    }
+
+    // Spare buffers of reorder, swapped with the arrays so that reordering does not allocate
+    std::vector<Scalar> scalar_scratch;
+    std::vector<sf::Color> color_scratch;
+    std::vector<uint8_t> flag_scratch;
+    std::vector<uint16_t> step_scratch;
+    std::vector<uint32_t> index_scratch;
+
+    // values[k] = values[order[k]], arrays another integrator leaves empty are skipped.
+    // The gathered array keeps at least the reserved capacity, so spawning after a reorder does not allocate.
+    template <typename Value>
+    static void gather(std::vector<Value>& values, const std::vector<uint32_t>& order, std::vector<Value>& scratch)
+    {
+        if (values.size() != order.size()) return;
+        scratch.reserve(values.capacity());
+        scratch.resize(order.size());
+        for (size_t k{0}; k < order.size(); ++k) scratch[k] = values[order[k]];
+        values.swap(scratch);
+    }
+
+    // Where balls were erased since the last updateSleep. The sleepers that touched one of them
+    // would otherwise hang in the air, updateSleep wakes those and only those.
+    struct Vacancy {
+        Scalar x, y, radius;
+    };
+    std::vector<Vacancy> vacated;
+
+    [[nodiscard]] bool touchesVacancy(size_t i) const
+    {
+        for (const Vacancy& hole : vacated) {
+            const Scalar dx = x[i] - hole.x, dy = y[i] - hole.y;
+            const Scalar reach = radius[i] + hole.radius + sleep_threshold;
+            if (dx * dx + dy * dy < reach * reach) return true;
+        }
+        return false;
+    }
+public:
+    // Verlet keeps the previous position, Euler and RK4 keep the velocity
+    static constexpr bool position_based = std::is_same_v<T, VerletBall>;
+    // Adaptive integrators keep a step size per particle
+    static constexpr bool adaptive = std::is_same_v<T, RK45Ball>;
+
+    std::vector<Scalar> x, y;
+    std::vector<Scalar> prev_x, prev_y; // position based only
+    std::vector<Scalar> vx, vy;         // velocity based only
+    std::vector<Scalar> trial_step;     // adaptive only, step size the next integration starts with
+    std::vector<Scalar> radius;
+    std::vector<sf::Color> color;
+    std::vector<Scalar> last_x, last_y; // position before the last physics step, for render interpolation
+    std::vector<uint8_t> asleep;        // skipped by integration and collisions until woken
+    std::vector<uint16_t> still_steps;  // consecutive steps within the sleep threshold of the anchor
+    std::vector<Scalar> anchor_x, anchor_y; // where the ball was when it last moved
+    std::vector<Scalar> ax, ay;         // acceleration from other balls this step (Forces::accumulate), empty for none
+
+    void reserve(size_t capacity)
+    {
+        x.reserve(capacity);
+        y.reserve(capacity);
+        if constexpr (position_based) {
+            prev_x.reserve(capacity);
+            prev_y.reserve(capacity);
+        } else {
+            vx.reserve(capacity);
+            vy.reserve(capacity);
+        }
+        if constexpr (adaptive) trial_step.reserve(capacity);
+        radius.reserve(capacity);
+        color.reserve(capacity);
+        last_x.reserve(capacity);
+        last_y.reserve(capacity);
+        asleep.reserve(capacity);
+        still_steps.reserve(capacity);
+        anchor_x.reserve(capacity);
+        anchor_y.reserve(capacity);
+        owner.reserve(capacity);
+        slot_index.reserve(capacity);
+        slot_generation.reserve(capacity);
+    }
+
+    // Same arguments as the Ball constructors
+    ParticleHandle emplace_back(Scalar r, Vec2 init_position, Scalar init_speed, Scalar angle)
+    {
+        uint32_t slot = free_slot;
+        if (slot != NO_SLOT) {
+            free_slot = slot_index[slot];
+        } else {
+            slot = static_cast<uint32_t>(slot_index.size());
+            slot_index.push_back(0);
+            slot_generation.push_back(0);
+        }
+        slot_index[slot] = static_cast<uint32_t>(size());
+        owner.push_back(slot);
+
+        const Vec2 velocity(utils::cos(angle) * init_speed * SCALE, utils::sin(angle) * init_speed * SCALE);
+        x.push_back(init_position.x);
+        y.push_back(init_position.y);
+        if constexpr (position_based) {
+            prev_x.push_back(init_position.x - velocity.x * deltaTime);
+            prev_y.push_back(init_position.y - velocity.y * deltaTime);
+        } else {
+            vx.push_back(velocity.x);
+            vy.push_back(velocity.y);
+        }
+        if constexpr (adaptive) trial_step.push_back(deltaTime);
+        radius.push_back(r);
+        color.emplace_back(0, 176, 255);
+        last_x.push_back(init_position.x);
+        last_y.push_back(init_position.y);
+        asleep.push_back(0);
+        still_steps.push_back(0);
+        anchor_x.push_back(init_position.x);
+        anchor_y.push_back(init_position.y);
+        return {slot, slot_generation[slot]};
+    }
+
+    // Remove a ball, the last ball takes its index. Returns false for a stale handle.
+    bool erase(ParticleHandle handle)
+    {
+        if (!isAlive(handle)) return false;
+        const size_t i = slot_index[handle.slot];
+        if (asleep[i]) --sleeping;
+        if (sleeping > 0) vacated.push_back({x[i], y[i], radius[i]});
+
+        for (auto* values : {&x, &y, &prev_x, &prev_y, &vx, &vy, &trial_step, &radius, &last_x, &last_y, &anchor_x, &anchor_y}) {
+            moveLast(*values, i);
+        }
+        moveLast(color, i);
+        moveLast(asleep, i);
+        moveLast(still_steps, i);
+        moveLast(owner, i);
+        if (i < size()) slot_index[owner[i]] = static_cast<uint32_t>(i);
+
+        ++slot_generation[handle.slot];
+        slot_index[handle.slot] = free_slot;
+        free_slot = handle.slot;
+        return true;
+    }
+
+    [[nodiscard]] bool isAlive(ParticleHandle handle) const
+    {
+        return handle.slot < slot_generation.size() && slot_generation[handle.slot] == handle.generation;
+    }
+
+    // Current index of a live ball
+    [[nodiscard]] size_t indexOf(ParticleHandle handle) const { return slot_index[handle.slot];}
+    [[nodiscard]] ParticleHandle handleOf(size_t i) const { return {owner[i], slot_generation[owner[i]]};}
+
+    // Move ball order[k] to index k for every k (a permutation of the indices), e.g. to sort the
+    // balls in space (Solver::reorderParticles). Handles follow their balls.
+    void reorder(const std::vector<uint32_t>& order)
+    {
+        if (order.size() != size()) return;
+        for (auto* values : {&x, &y, &prev_x, &prev_y, &vx, &vy, &trial_step, &radius, &last_x, &last_y,
+                             &anchor_x, &anchor_y, &ax, &ay}) {
+            gather(*values, order, scalar_scratch);
+        }
+        gather(color, order, color_scratch);
+        gather(asleep, order, flag_scratch);
+        gather(still_steps, order, step_scratch);
+        gather(owner, order, index_scratch);
+        for (size_t i{0}; i < size(); ++i) slot_index[owner[i]] = static_cast<uint32_t>(i);
+    }
+
+    // After the arrays were replaced wholesale (snapshot load): every old handle goes stale
+    // and ball i gets slot i
+    void resetHandles()
+    {
+        for (auto& generation : slot_generation) ++generation;
+        if (slot_index.size() < size()) {
+            slot_index.resize(size());
+            slot_generation.resize(size(), 0);
+        }
+        owner.resize(size());
+        for (size_t i{0}; i < size(); ++i) {
+            owner[i]      = static_cast<uint32_t>(i);
+            slot_index[i] = static_cast<uint32_t>(i);
+        }
+        free_slot = NO_SLOT;
+        for (size_t slot{slot_index.size()}; slot-- > size();) {
+            slot_index[slot] = free_slot;
+            free_slot = static_cast<uint32_t>(slot);
+        }
+    }
+
+    // After asleep was replaced wholesale (snapshot load)
+    void recountSleeping()
+    {
+        sleeping = static_cast<size_t>(std::count(asleep.begin(), asleep.end(), uint8_t{1}));
+        vacated.clear();
+    }
+
+    void setColor(size_t i, const sf::Color& c) { color[i] = c;}
+    void setStepSize(const Scalar& dt) { deltaTime = dt;}
+
+    [[nodiscard]] Scalar getStepSize() const { return deltaTime;}
+    [[nodiscard]] size_t size() const { return x.size();}
+    [[nodiscard]] bool empty() const { return x.empty();}
+
+    [[nodiscard]] Vec2 getPosition(size_t i) const
+    {
+        return {x[i], y[i]};
+    }
+
+    [[nodiscard]] Vec2 getVelocity(size_t i) const
+    {
+        if constexpr (position_based) {
+            return Vec2(x[i] - prev_x[i], y[i] - prev_y[i]) / deltaTime;
+        } else {
+            return {vx[i], vy[i]};
+        }
+    }
+
+    // Verlet moves the previous position so that the ball keeps its current position
+    void setVelocity(size_t i, Vec2 velocity)
+    {
+        if constexpr (position_based) {
+            prev_x[i] = x[i] - velocity.x * deltaTime;
+            prev_y[i] = y[i] - velocity.y * deltaTime;
+        } else {
+            vx[i] = velocity.x;
+            vy[i] = velocity.y;
+        }
+    }
+
+    // Bytes of state stored per particle
+    [[nodiscard]] static constexpr size_t bytesPerParticle()
+    {
+        return (adaptive ? 10 : 9) * sizeof(Scalar) + sizeof(sf::Color) + sizeof(uint8_t) + sizeof(uint16_t)
+             + 3 * sizeof(uint32_t);
+    }
+
+    // Balls that stay within threshold pixels of the same spot for steps steps fall asleep.
+    // Drift is measured from an anchor rather than per step (x - prev) because balls deep in a
+    // pile keep jittering in place and rarely show a small per step velocity.
+    // Sleeping balls are not integrated and hold still against awake balls, only a hit faster
+    // than wake_speed pixels per step wakes them (Solver::sleeperPair).
+    void setSleeping(bool enabled, Scalar threshold = 2.f, uint16_t steps = 15, Scalar wake_speed = 4.f)
+    {
+        sleep_enabled   = enabled;
+        sleep_threshold = threshold;
+        sleep_steps     = std::max<uint16_t>(steps, 1);
+        wake_threshold  = wake_speed;
+        if (!enabled) wakeAll();
+    }
+
+    [[nodiscard]] bool isSleepingEnabled() const { return sleep_enabled;}
+    [[nodiscard]] size_t getSleepingCount() const { return sleeping;}
+    // Balls were erased next to sleepers since the last updateSleep
+    [[nodiscard]] bool hasVacancies() const { return !vacated.empty();}
+    [[nodiscard]] bool isAsleep(size_t i) const { return asleep[i] != 0;}
+
+    [[nodiscard]] bool isMovingFast(size_t i) const
+    {
+        const Vec2 step = getVelocity(i) * deltaTime;
+        return step.x * step.x + step.y * step.y > wake_threshold * wake_threshold;
+    }
+
+    void wake(size_t i)
+    {
+        asleep[i]      = 0;
+        still_steps[i] = 0;
+        anchor_x[i]    = x[i];
+        anchor_y[i]    = y[i];
+    }
+
+    void wakeAll()
+    {
+        asleep.assign(size(), 0);
+        still_steps.assign(size(), 0);
+        anchor_x = x;
+        anchor_y = y;
+        sleeping = 0;
+        vacated.clear();
+    }
+
+    // Call once per step after collisions. A ball that drifted away from its anchor, or that
+    // touched a ball erased since the last call, is awake and anchored again.
+    void updateSleep()
+    {
+        if (!sleep_enabled) return;
+        const Scalar threshold2 = sleep_threshold * sleep_threshold;
+        sleeping = 0;
+        for (size_t i{0}; i < size(); ++i) {
+            const Scalar dx = x[i] - anchor_x[i], dy = y[i] - anchor_y[i];
+            if (dx * dx + dy * dy > threshold2 || (asleep[i] && !vacated.empty() && touchesVacancy(i))) {
+                anchor_x[i]    = x[i];
+                anchor_y[i]    = y[i];
+                asleep[i]      = 0;
+                still_steps[i] = 0;
+                continue;
+            }
+            if (asleep[i]) {
+                ++sleeping;
+                continue;
+            }
+            if (++still_steps[i] < sleep_steps) continue;
+
+            // Come to a full stop so the ball wakes up at rest
+            asleep[i] = 1;
+            ++sleeping;
+            if constexpr (position_based) {
+                prev_x[i] = x[i];
+                prev_y[i] = y[i];
+            } else {
+                vx[i] = Scalar(0);
+                vy[i] = Scalar(0);
+            }
+        }
+        vacated.clear();
+    }
+
+    // Advance every particle by one step
+    void updatePositions() { updatePositions(0, size());}
+
+    // Advance the balls in [first, last) by one step, specialized next to each ball type.
+    // Balls only read their own state here, so disjoint ranges can run on different threads.
+    void updatePositions(size_t first, size_t last);
+
+    // Whether Forces::accumulate left interaction accelerations for the current balls
+    [[nodiscard]] bool hasInteractions() const { return !ax.empty() && ax.size() == size();}
+
+    // Remember the current positions as the start of the next physics step
+    void saveRenderState()
+    {
+        last_x = x;
+        last_y = y;
+    }
+
+    // alpha blends between the last two physics states (0 = previous, 1 = current), in screen floats
+    [[nodiscard]] sf::Vector2f getRenderPosition(size_t i, float alpha) const
+    {
+        const sf::Vector2f last(static_cast<float>(last_x[i]), static_cast<float>(last_y[i]));
+        const sf::Vector2f now(static_cast<float>(x[i]), static_cast<float>(y[i]));
+        return {last.x + alpha * (now.x - last.x), last.y + alpha * (now.y - last.y)};
+    }
+
+    void draw(sf::RenderWindow& window, float alpha = 1.f) const
+    {
+        sf::CircleShape shape;
+        for (size_t i{0}; i < size(); ++i) {
+            const float r = static_cast<float>(radius[i]);
+            shape.setRadius(r);
+            shape.setOrigin(r, r);
+            shape.setPosition(getRenderPosition(i, alpha));
+            shape.setFillColor(color[i]);
+            window.draw(shape);
+        }
+    }
+};
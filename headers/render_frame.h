@@ -0,0 +1,90 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "particles.h"
+#include "solver.h"
+#include "wall.h"
+
+// What the window needs of one physics step, copied out by the simulation thread so that drawing
+// never reads the store while a step is running. Slots of a TripleBuffer<RenderFrame> are refilled,
+// the arrays only grow.
+struct RenderFrame {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<sf::Vector2f> last, now;    // ball centres before and after the step, in screen floats
+    std::vector<float> radius;
+    std::vector<sf::Color> color;
+    std::vector<Wall> walls;                // the walls the step collided with, drawn under the balls
+
+    uint64_t step          = 0;             // physics steps taken so far
+    float step_size        = 1.f / 120.f;
+    Clock::time_point published;            // when the step ended, rendering blends towards it from there
+    size_t asleep          = 0;
+    PairStats pairs;
+    BroadPhase broad_phase = BroadPhase::Grid;
+    ContactSolver contact_solver = ContactSolver::GaussSeidel;
+    std::vector<float> utilization;         // share of its run time each thread of the step graph spent in tasks
+
+    template <typename T>
+    void capture(const ParticleStore<T>& balls, const std::vector<Wall>& layout, uint64_t step_count, float step_seconds)
+    {
+        resize(balls.size());
+        pack(balls, 0, balls.size());
+        stamp(balls, layout, step_count, step_seconds);
+    }
+
+    // capture in parts, for a step that packs the frame as one of its phases (StepGraph):
+    // resize to the ball count, pack every range of balls, possibly on several threads, then stamp
+    void resize(size_t count)
+    {
+        last.resize(count);
+        now.resize(count);
+        radius.resize(count);
+        color.resize(count);
+    }
+
+    template <typename T>
+    void pack(const ParticleStore<T>& balls, size_t begin, size_t end)
+    {
+        for (size_t i{begin}; i < end; ++i) {
+            last[i]   = {static_cast<float>(balls.last_x[i]), static_cast<float>(balls.last_y[i])};
+            now[i]    = {static_cast<float>(balls.x[i]), static_cast<float>(balls.y[i])};
+            radius[i] = static_cast<float>(balls.radius[i]);
+            color[i]  = balls.color[i];
+        }
+    }
+
+    template <typename T>
+    void stamp(const ParticleStore<T>& balls, const std::vector<Wall>& layout, uint64_t step_count, float step_seconds)
+    {
+        walls.clear();                  // Wall is not assignable, the walls are copied in one by one
+        for (const Wall& wall : layout) walls.push_back(wall);
+        step           = step_count;
+        step_size      = step_seconds;
+        published      = Clock::now();
+        asleep         = balls.getSleepingCount();
+        pairs          = Solver::getPairStats();
+        broad_phase    = Solver::getBroadPhase();
+        contact_solver = Solver::getContactSolver();
+    }
+
+    [[nodiscard]] size_t size() const { return now.size();}
+
+    // How far the display is into the step after this one (0-1), the same role as the alpha of
+    // FixedStepScheduler::advance but measured on the clock of the thread that draws
+    [[nodiscard]] float alphaAt(Clock::time_point time) const
+    {
+        const float elapsed = std::chrono::duration<float>(time - published).count();
+        return std::clamp(elapsed / step_size, 0.f, 1.f);
+    }
+
+    // Same blend as ParticleStore::getRenderPosition
+    [[nodiscard]] sf::Vector2f getRenderPosition(size_t i, float alpha) const
+    {
+        return last[i] + alpha * (now[i] - last[i]);
+    }
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "particles.h"
+#include "render_frame.h"
+#include "wall.h"
+
+// Draws every ball, wall and line of a frame with a single draw call.
+// Balls are textured quads (two triangles) sampling a circle from a small texture,
+// walls and lines sample a solid white block of the same texture so they fit in the same batch.
+// The vertex buffer is kept between frames and only grows.
+class BatchRenderer {
+private:
+    static constexpr unsigned CIRCLE_SIZE = 64;
+
+    sf::Texture texture;
+    sf::VertexArray vertices{sf::Triangles};
+    size_t used = 0;
+
+    const sf::Vector2f solid_texel{1.5f * CIRCLE_SIZE, 0.5f * CIRCLE_SIZE};
+
+    void createTexture()
+    {
+        sf::Image image;
+        image.create(2 * CIRCLE_SIZE, CIRCLE_SIZE, sf::Color::Transparent);
+
+        // Anti-aliased white disc on the left half
+        const float centre = 0.5f * CIRCLE_SIZE;
+        const float radius = centre - 1.f;
+        for (unsigned y{0}; y < CIRCLE_SIZE; ++y) {
+            for (unsigned x{0}; x < CIRCLE_SIZE; ++x) {
+                const float dx = x + 0.5f - centre;
+                const float dy = y + 0.5f - centre;
+                const float coverage = std::clamp(radius - std::sqrt(dx * dx + dy * dy) + 0.5f, 0.f, 1.f);
+                image.setPixel(x, y, sf::Color(255, 255, 255, static_cast<uint8_t>(255.f * coverage)));
+            }
+        }
+
+        // Solid white block on the right half for untextured geometry
+        for (unsigned y{0}; y < CIRCLE_SIZE; ++y) {
+            for (unsigned x{CIRCLE_SIZE}; x < 2 * CIRCLE_SIZE; ++x) {
+                image.setPixel(x, y, sf::Color::White);
+            }
+        }
+
+        texture.loadFromImage(image);
+        texture.setSmooth(true);
+    }
+
+    // Make room for count more vertices and return the first one
+    sf::Vertex* allocate(size_t count)
+    {
+        if (used + count > vertices.getVertexCount()) {
+            vertices.resize(used + count);
+        }
+        sf::Vertex* first = &vertices[used];
+        used += count;
+        return first;
+    }
+
+    void addQuad(const sf::Vector2f (&corners)[4], const sf::Vector2f (&tex)[4], const sf::Color& color)
+    {
+        static constexpr int order[6] = {0, 1, 2, 0, 2, 3};
+        sf::Vertex* v = allocate(6);
+        for (int k{0}; k < 6; ++k) {
+            v[k].position  = corners[order[k]];
+            v[k].texCoords = tex[order[k]];
+            v[k].color     = color;
+        }
+    }
+
+public:
+    BatchRenderer()
+    {
+        createTexture();
+    }
+
+    // Start a new frame, keeps the allocated vertices
+    void clear()
+    {
+        used = 0;
+    }
+
+    // Make room for this many more balls in the current frame
+    void reserve(size_t balls)
+    {
+        if (vertices.getVertexCount() < used + 6 * balls) vertices.resize(used + 6 * balls);
+    }
+
+    void addBall(sf::Vector2f centre, float radius, const sf::Color& color)
+    {
+        const float size = static_cast<float>(CIRCLE_SIZE);
+        const sf::Vector2f corners[4] = {
+            {centre.x - radius, centre.y - radius}, {centre.x + radius, centre.y - radius},
+            {centre.x + radius, centre.y + radius}, {centre.x - radius, centre.y + radius}};
+        const sf::Vector2f tex[4] = {{0.f, 0.f}, {size, 0.f}, {size, size}, {0.f, size}};
+        addQuad(corners, tex, color);
+    }
+
+    // alpha interpolates between the last two physics states, see ParticleStore::getRenderPosition
+    template <typename T>
+    void addBalls(const ParticleStore<T>& balls, float alpha = 1.f)
+    {
+        reserve(balls.size());
+        for (size_t i{0}; i < balls.size(); ++i) {
+            addBall(balls.getRenderPosition(i, alpha), static_cast<float>(balls.radius[i]), balls.color[i]);
+        }
+    }
+
+    void addBalls(const RenderFrame& frame, float alpha = 1.f)
+    {
+        reserve(frame.size());
+        for (size_t i{0}; i < frame.size(); ++i) {
+            addBall(frame.getRenderPosition(i, alpha), frame.radius[i], frame.color[i]);
+        }
+    }
+
+    void addLine(sf::Vector2f from, sf::Vector2f to, const sf::Color& color, float thickness = 2.f)
+    {
+        const sf::Vector2f direction = utils::normalize(to - from);
+        const sf::Vector2f offset    = sf::Vector2f(-direction.y, direction.x) * (0.5f * thickness);
+        const sf::Vector2f corners[4] = {from - offset, to - offset, to + offset, from + offset};
+        const sf::Vector2f tex[4] = {solid_texel, solid_texel, solid_texel, solid_texel};
+        addQuad(corners, tex, color);
+    }
+
+    void addTriangle(sf::Vector2f a, sf::Vector2f b, sf::Vector2f c, const sf::Color& color)
+    {
+        sf::Vertex* v = allocate(3);
+        v[0] = sf::Vertex(a, color, solid_texel);
+        v[1] = sf::Vertex(b, color, solid_texel);
+        v[2] = sf::Vertex(c, color, solid_texel);
+    }
+
+    void addWall(const Wall& wall, const sf::Color& color = sf::Color::White)
+    {
+        // Same rectangle as Wall::draw: length along the incline, width along the rotated y axis
+        const sf::Vector2f along(wall.getDirection());
+        const sf::Vector2f across(-along.y, along.x);
+        const sf::Vector2f start(wall.getStartingPoint());
+        const sf::Vector2f end(wall.getEndingPoint());
+        const sf::Vector2f thick = across * static_cast<float>(wall.getWidth());
+
+        const sf::Vector2f corners[4] = {start, end, end + thick, start + thick};
+        const sf::Vector2f tex[4] = {solid_texel, solid_texel, solid_texel, solid_texel};
+        addQuad(corners, tex, color);
+    }
+
+    void addWalls(const std::vector<Wall>& walls)
+    {
+        for (auto& wall : walls) addWall(wall);
+    }
+
+    void draw(sf::RenderTarget& target) const
+    {
+        if (used == 0) return;
+        target.draw(&vertices[0], used, sf::Triangles, sf::RenderStates(&texture));
+    }
+
+    [[nodiscard]] size_t getVertexCount() const { return used;}
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "particles.h"
+
+// Log of the balls shot by the user, keyed by physics step.
+// Shots are queued here instead of being added straight to the store and are applied at
+// the start of their step, so a recorded run replays bit-for-bit from the same seed or snapshot.
+//
+//   ReplayHeader, then one Shot per user input in step order
+struct ReplayHeader {
+    char magic[4]       = {'E', 'V', 'R', 'P'};
+    uint32_t version    = 1;
+    uint32_t seed       = 0;
+    uint32_t substeps   = 1;
+    float physics_rate  = 120.f;
+    uint32_t reserved   = 0;
+    uint64_t start_step = 0;        // step of the snapshot the run started from, 0 for a fresh run
+};
+
+struct Shot {
+    uint64_t step;
+    float radius;
+    float x, y;
+    float speed;
+    float angle;
+};
+
+class ReplayLog {
+private:
+    ReplayHeader header;
+    std::vector<Shot> shots;
+    size_t next = 0;                // first shot not applied yet
+    std::FILE* file = nullptr;      // open while recording
+    bool replaying = false;
+
+public:
+    ReplayLog() = default;
+    ~ReplayLog() { stopRecording();}
+    ReplayLog(const ReplayLog&) = delete;
+    ReplayLog& operator=(const ReplayLog&) = delete;
+
+    // Every recorded shot is flushed right away so the log survives a crash
+    bool startRecording(const std::string& path, const ReplayHeader& run)
+    {
+        stopRecording();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        header = run;
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fflush(file);
+        return true;
+    }
+
+    void stopRecording()
+    {
+        if (file) std::fclose(file);
+        file = nullptr;
+    }
+
+    bool load(const std::string& path)
+    {
+        std::FILE* input = std::fopen(path.c_str(), "rb");
+        if (!input) return false;
+
+        ReplayHeader loaded;
+        bool ok = std::fread(&loaded, sizeof(loaded), 1, input) == 1
+               && std::memcmp(loaded.magic, ReplayHeader().magic, 4) == 0
+               && loaded.version == ReplayHeader().version;
+        if (ok) {
+            header = loaded;
+            shots.clear();
+            Shot shot;
+            while (std::fread(&shot, sizeof(shot), 1, input) == 1) shots.push_back(shot);
+            next = 0;
+            replaying = true;
+        }
+        std::fclose(input);
+        return ok;
+    }
+
+    // Queue a user shot for the given physics step, ignored while replaying
+    void record(const Shot& shot)
+    {
+        if (replaying) return;
+        shots.push_back(shot);
+        if (file) {
+            std::fwrite(&shot, sizeof(shot), 1, file);
+            std::fflush(file);
+        }
+    }
+
+    // Add the shots of this step, call at the start of every physics step
+    template <typename T>
+    void apply(ParticleStore<T>& balls, uint64_t step)
+    {
+        // Shots older than the current step (recorded before a snapshot was loaded) are dropped
+        while (next < shots.size() && shots[next].step < step) ++next;
+        for (; next < shots.size() && shots[next].step == step; ++next) {
+            const Shot& shot = shots[next];
+            balls.emplace_back(shot.radius, {shot.x, shot.y}, shot.speed, shot.angle);
+        }
+    }
+
+    [[nodiscard]] const ReplayHeader& getHeader() const { return header;}
+    [[nodiscard]] size_t getShotCount() const { return shots.size();}
+    [[nodiscard]] bool isRecording() const { return file != nullptr;}
+    [[nodiscard]] bool isReplaying() const { return replaying;}
+};
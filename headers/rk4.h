@@ -1,20 +1,24 @@
 #pragma once
 #include "ball.h"
+#include "particles.h"
+#include "forces.h"
+
+class RK45Ball;
 
 struct State {
-    sf::Vector2f position;
-    sf::Vector2f velocity;
+    Vec2 position;
+    Vec2 velocity;
 };
 
 struct Derivative {
-    sf::Vector2f dPosition;     // dx/dt = velocity
-    sf::Vector2f dVelocity;     // dv/dt = acceleration
+    Vec2 dPosition;     // dx/dt = velocity
+    Vec2 dVelocity;     // dv/dt = acceleration
 };
 
 class RK4Ball : public Ball {
 private:
     State state;
-    Derivative Function(const State& initial, float dt, const Derivative& derivative) {
+    Derivative Function(const State& initial, Scalar dt, const Derivative& derivative) {
         State state;
         state.position = initial.position + derivative.dPosition * dt;
         state.velocity = initial.velocity + derivative.dVelocity * dt;
@@ -25,14 +29,14 @@ private:
         return output;
     }
 public:
-    RK4Ball(float radius, sf::Vector2f init_position, float init_speed, float angle)
+    RK4Ball(Scalar radius, Vec2 init_position, Scalar init_speed, Scalar angle)
         : Ball(radius, init_position, init_speed, angle) 
     {
         state.position = position;
         state.velocity = velocity;
     }
 
-    [[nodiscard]] sf::Vector2f getPosition() const
+    [[nodiscard]] Vec2 getPosition() const
     {
         return state.position;
     }
@@ -44,21 +48,21 @@ public:
         Derivative c = Function(state, deltaTime * 0.5f, b);
         Derivative d = Function(state, deltaTime, c);
 
-        sf::Vector2f dxdt = (a.dPosition + 2.f * (b.dPosition + c.dPosition) + d.dPosition) / 6.f;
-        sf::Vector2f dvdt = (a.dVelocity + 2.f * (b.dVelocity + c.dVelocity) + d.dVelocity) / 6.f;
+        Vec2 dxdt = (a.dPosition + Scalar(2) * (b.dPosition + c.dPosition) + d.dPosition) / Scalar(6);
+        Vec2 dvdt = (a.dVelocity + Scalar(2) * (b.dVelocity + c.dVelocity) + d.dVelocity) / Scalar(6);
 
         state.position += dxdt * deltaTime;
         state.velocity += dvdt * deltaTime;
         
-        circleObject.setPosition(state.position);
+        setShapePosition(state.position);
     }
 
-    [[nodiscard]] sf::Vector2f getVelocity() const
+    [[nodiscard]] Vec2 getVelocity() const
     {
         return state.velocity;
     }
 
-    [[nodiscard]] float getSpeed() const noexcept
+    [[nodiscard]] Scalar getSpeed() const noexcept
     {
         return utils::norm2f(state.velocity);
     }
@@ -69,15 +73,43 @@ public:
 
 
 
+template<>
+inline void ParticleStore<RK4Ball>::updatePositions(size_t first, size_t last)
+{
+    // Same four stages as RK4Ball::updatePosition, the local fields evaluated at each stage
+    // and the interactions held over the step
+    const bool interacting = hasInteractions();
+    for (size_t i{first}; i < last; ++i) {
+        if (asleep[i]) continue;
+        const State state{{x[i], y[i]}, {vx[i], vy[i]}};
+        const Vec2 interaction = interacting ? Vec2{ax[i], ay[i]} : Vec2{};
+        auto evaluate = [&](Scalar dt, const Derivative& derivative) {
+            const Vec2 position = state.position + derivative.dPosition * dt;
+            const Vec2 velocity = state.velocity + derivative.dVelocity * dt;
+            return Derivative{velocity, Forces::at(position, velocity) + interaction};
+        };
+        Derivative a = evaluate(0.f, Derivative());
+        Derivative b = evaluate(deltaTime * 0.5f, a);
+        Derivative c = evaluate(deltaTime * 0.5f, b);
+        Derivative d = evaluate(deltaTime, c);
+
+        Vec2 dxdt = (a.dPosition + Scalar(2) * (b.dPosition + c.dPosition) + d.dPosition) / Scalar(6);
+        Vec2 dvdt = (a.dVelocity + Scalar(2) * (b.dVelocity + c.dVelocity) + d.dVelocity) / Scalar(6);
+
+        x[i]  += dxdt.x * deltaTime;
+        y[i]  += dxdt.y * deltaTime;
+        vx[i] += dvdt.x * deltaTime;
+        vy[i] += dvdt.y * deltaTime;
+    }
+}
+
+
 template<>
 class CollisionSolver<RK4Ball> {
 CollisionSolver() = default;
+    friend class CollisionSolver<RK45Ball>;   // shares the pair impulses
 
-public:
-    static void handleBorderCollision(RK4Ball& ball, const int& windowWidth, const int& windowHeight){
-        auto& state  = ball.state;
-        auto& radius = ball.radius;
-
+    static void bounceOffBorder(State& state, const Scalar radius, const int windowWidth, const int windowHeight){
         if (state.position.x + radius > windowWidth) {
             state.position.x = windowWidth - radius;
             state.velocity.x *= -RESTITUTION;
@@ -94,69 +126,124 @@ public:
             state.position.y = radius;
             state.velocity.y *= -RESTITUTION;
         }
-        ball.circleObject.setPosition(state.position);
     }
 
-    static void resolvePairCollision(RK4Ball& ballA, RK4Ball& ballB) {
-        sf::Vector2f& posA = ballA.state.position;
-        sf::Vector2f& posB = ballB.state.position;
-        sf::Vector2f& velA = ballA.state.velocity;
-        sf::Vector2f& velB = ballB.state.velocity;
+    // Returns false if the balls do not touch
+    static bool collide(State& stateA, State& stateB, const Scalar radiusA, const Scalar radiusB) {
+        Vec2& posA = stateA.position;
+        Vec2& posB = stateB.position;
+        Vec2& velA = stateA.velocity;
+        Vec2& velB = stateB.velocity;
 
-        sf::Vector2f delta = posB - posA;
-        float dist2        = delta.x * delta.x + delta.y * delta.y;
-        float min_dist     = ballA.radius + ballB.radius;
+        Vec2 delta = posB - posA;
+        Scalar dist2        = delta.x * delta.x + delta.y * delta.y;
+        Scalar min_dist     = radiusA + radiusB;
 
         if (dist2 < min_dist * min_dist) {
-            float dist = std::sqrt(dist2);
-            float overlap = min_dist - dist;
-            sf::Vector2f normal = delta / dist;
+            Scalar dist = utils::sqrt(dist2);
+            Scalar overlap = min_dist - dist;
+            // Coincident centres (both clamped into the same corner) part along x
+            Vec2 normal = dist > Scalar(0) ? delta / dist : Vec2{1.f, 0.f};
 
-            const float mass_ratioA = ballA.radius / min_dist;
-            const float mass_ratioB = ballB.radius / min_dist;
+            const Scalar mass_ratioA = radiusA / min_dist;
+            const Scalar mass_ratioB = radiusB / min_dist;
 
-            // sf::Vector2f correction = normal * RESTITUTION * overlap;
-            sf::Vector2f correction = normal * overlap;
+            // Vec2 correction = normal * RESTITUTION * overlap;
+            Vec2 correction = normal * overlap;
 
             posA -= correction * mass_ratioB;
             posB += correction * mass_ratioA;
 
-            ballA.circleObject.setPosition(posA);
-            ballB.circleObject.setPosition(posB);
-
             // Velocity calculation
-            sf::Vector2f relative_velocity = velB - velA;
-            float velocity_along_normal = utils::dot(relative_velocity, normal);
+            Vec2 relative_velocity = velB - velA;
+            Scalar velocity_along_normal = utils::dot(relative_velocity, normal);
 
             // Only resolve if moving towards each other
-            if (velocity_along_normal > 0) return;
+            if (velocity_along_normal > 0) return true;
 
             // Impulse scalar with energy loss
-            float impulseScalar = -(1.f + RESTITUTION) * velocity_along_normal;
-            sf::Vector2f impulse = normal * impulseScalar;
+            Scalar impulseScalar = -(1.f + RESTITUTION) * velocity_along_normal;
+            Vec2 impulse = normal * impulseScalar;
 
             velA -= impulse * mass_ratioB;
             velB += impulse * mass_ratioA;
-
+            return true;
         }
+        return false;
     }
 
-    static void resolveWallCollision(RK4Ball& ball, Wall& wall) {
-        sf::Vector2f closest_point = closestPointToWall(ball, wall);
-        sf::Vector2f ball_to_closest = closest_point - ball.state.position;
-        float dist = utils::norm2f(ball_to_closest);
-        sf::Vector2f normal = utils::normalize(ball_to_closest);
+    static bool bounceOffWall(State& state, const Scalar radius, const Wall& wall) {
+        Vec2 closest_point = closestPointToWall(state.position, wall);
+        Vec2 ball_to_closest = closest_point - state.position;
+        Scalar dist = utils::norm2f(ball_to_closest);
+        Vec2 normal = utils::normalize(ball_to_closest);
 
-        float overlap = ball.radius - dist;
-        if (dist < ball.radius) {
+        Scalar overlap = radius - dist;
+        if (dist < radius) {
             // Position correction (push ball out of wall)
-            ball.state.position -= normal * overlap;
-            ball.circleObject.setPosition(ball.state.position);
+            state.position -= normal * overlap;
 
             // Reflect velocity using proper restitution
-            float velocity_along_normal = utils::dot(ball.state.velocity, normal);
-            ball.state.velocity -= (1.f + RESTITUTION) * velocity_along_normal * normal;
-            ball.state.velocity *= wall.WALL_FRICTION;
+            Scalar velocity_along_normal = utils::dot(state.velocity, normal);
+            state.velocity -= (1.f + RESTITUTION) * velocity_along_normal * normal;
+            state.velocity *= wall.WALL_FRICTION;
+            return true;
         }
+        return false;
+    }
+
+    static State loadState(const ParticleStore<RK4Ball>& balls, size_t i) {
+        return {{balls.x[i], balls.y[i]}, {balls.vx[i], balls.vy[i]}};
+    }
+
+    static void storeState(ParticleStore<RK4Ball>& balls, size_t i, const State& state) {
+        balls.x[i]  = state.position.x;    balls.y[i]  = state.position.y;
+        balls.vx[i] = state.velocity.x;    balls.vy[i] = state.velocity.y;
     }
-};
\ No newline at end of file
+
+public:
+    static void handleBorderCollision(RK4Ball& ball, const int& windowWidth, const int& windowHeight){
+        bounceOffBorder(ball.state, ball.radius, windowWidth, windowHeight);
+        ball.setShapePosition(ball.state.position);
+    }
+
+    static bool resolvePairCollision(RK4Ball& ballA, RK4Ball& ballB) {
+        if (collide(ballA.state, ballB.state, ballA.radius, ballB.radius)) {
+            ballA.setShapePosition(ballA.state.position);
+            ballB.setShapePosition(ballB.state.position);
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(RK4Ball& ball, const Wall& wall) {
+        if (bounceOffWall(ball.state, ball.radius, wall)) {
+            ball.setShapePosition(ball.state.position);
+        }
+    }
+
+    // Structure-of-arrays versions, i and j index into the store
+    static void handleBorderCollision(ParticleStore<RK4Ball>& balls, size_t i, const int& windowWidth, const int& windowHeight){
+        State state = loadState(balls, i);
+        bounceOffBorder(state, balls.radius[i], windowWidth, windowHeight);
+        storeState(balls, i, state);
+    }
+
+    static bool resolvePairCollision(ParticleStore<RK4Ball>& balls, size_t i, size_t j) {
+        State stateA = loadState(balls, i);
+        State stateB = loadState(balls, j);
+        if (collide(stateA, stateB, balls.radius[i], balls.radius[j])) {
+            storeState(balls, i, stateA);
+            storeState(balls, j, stateB);
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(ParticleStore<RK4Ball>& balls, size_t i, const Wall& wall) {
+        State state = loadState(balls, i);
+        if (bounceOffWall(state, balls.radius[i], wall)) {
+            storeState(balls, i, state);
+        }
+    }
+};
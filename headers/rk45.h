@@ -0,0 +1,291 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include "ball.h"
+#include "particles.h"
+#include "rk4.h"
+#include "forces.h"
+
+// Dormand–Prince 5(4): seven stages give a fifth order step and an embedded fourth order
+// one, their difference estimates the local error. Steps grow while the error stays under
+// the tolerance and shrink where the field changes quickly, each ball keeping its own step
+// size between physics steps. The last stage is the first of the next step (FSAL), so an
+// accepted step costs six field evaluations.
+namespace dormand_prince {
+
+// Acceleration in pixels/s² at a position and velocity
+using Field = Vec2 (*)(Vec2 position, Vec2 velocity);
+
+struct Settings {
+    Field field        = Forces::at;    // local fields, interactions are passed to advance
+    Scalar tolerance    = 0.01f;     // local error allowed per step, in pixels
+    Scalar min_step     = 1e-5f;     // seconds, steps this small are accepted whatever their error
+    uint32_t max_steps = 64;        // per physics step, the remaining time is then taken in one step
+};
+inline Settings settings;
+// Field evaluations so far, to compare against fixed step integrators. Counted once per advance,
+// ranges of balls may be integrated on several threads.
+inline std::atomic<uint64_t> evaluations{0};
+
+inline Derivative evaluate(const State& state, Vec2 interaction)
+{
+    return {state.velocity, settings.field(state.position, state.velocity) + interaction};
+}
+
+// Butcher tableau, row i gives stage i from the stages before it. Row 6 is the fifth order solution.
+inline constexpr Scalar A[7][6] = {
+    {},
+    {1.f / 5.f},
+    {3.f / 40.f, 9.f / 40.f},
+    {44.f / 45.f, -56.f / 15.f, 32.f / 9.f},
+    {19372.f / 6561.f, -25360.f / 2187.f, 64448.f / 6561.f, -212.f / 729.f},
+    {9017.f / 3168.f, -355.f / 33.f, 46732.f / 5247.f, 49.f / 176.f, -5103.f / 18656.f},
+    {35.f / 384.f, 0.f, 500.f / 1113.f, 125.f / 192.f, -2187.f / 6784.f, 11.f / 84.f},
+};
+
+// Fifth minus fourth order weights
+inline constexpr Scalar E[7] = {
+    71.f / 57600.f, 0.f, -71.f / 16695.f, 71.f / 1920.f, -17253.f / 339200.f, 22.f / 525.f, -1.f / 40.f
+};
+
+// Advance state by dt in as many steps as the tolerance needs. step is the size the first
+// step tries and is updated for the next call. interaction is the acceleration from other
+// balls (Forces::accumulate), held over the step.
+inline void advance(State& state, Scalar dt, Scalar& step, Vec2 interaction = {})
+{
+    Derivative k[7];
+    k[0] = evaluate(state, interaction);
+
+    Scalar t = 0.f;
+    uint64_t evaluated = 1;
+    for (uint32_t n{0}; t < dt; ++n) {
+        const bool last_chance = n + 1 >= settings.max_steps;
+        const Scalar h = last_chance ? dt - t : std::min(step, dt - t);
+
+        State next;
+        for (int i{1}; i < 7; ++i) {
+            next = state;
+            for (int j{0}; j < i; ++j) {
+                next.position += k[j].dPosition * (h * A[i][j]);
+                next.velocity += k[j].dVelocity * (h * A[i][j]);
+            }
+            k[i] = evaluate(next, interaction);
+        }
+        evaluated += 6;
+
+        Vec2 position_error, velocity_error;
+        for (int j{0}; j < 7; ++j) {
+            position_error += k[j].dPosition * (h * E[j]);
+            velocity_error += k[j].dVelocity * (h * E[j]);
+        }
+        // Velocity error counted as the distance it would drift over the step
+        const Scalar error = utils::norm2f(position_error) + h * utils::norm2f(velocity_error);
+
+        const Scalar factor = error > 0.f
+                           ? std::clamp(Scalar(0.9f) * utils::pow(settings.tolerance / error, Scalar(0.2f)), Scalar(0.2f), Scalar(5))
+                           : 5.f;
+        const bool accepted = error <= settings.tolerance || h <= settings.min_step || last_chance;
+
+        // A step cut short by the end of the physics step says little about the size to try next
+        const Scalar proposal = std::max(h * factor, settings.min_step);
+        step = (accepted && h < step) ? std::max(step, proposal) : proposal;
+
+        if (!accepted) continue;
+        state = next;
+        k[0]  = k[6];
+        t    += h;
+    }
+    evaluations.fetch_add(evaluated, std::memory_order_relaxed);
+}
+
+// Event location for a contact found after the step: the ball crossed the surface whose
+// normal (pointing into the obstacle) is given and is now depth pixels inside.
+// Rewinds to the moment of contact, reflects there and moves on for the rest of the step,
+// instead of clamping the position and keeping the velocity of a ball already inside.
+// Returns false when no contact time within the last dt explains the overlap (resting contact).
+inline bool bounceAtContact(State& state, Vec2 normal, Scalar depth, Scalar dt)
+{
+    const Vec2 acceleration = settings.field(state.position, state.velocity);
+    const Scalar speed = utils::dot(state.velocity, normal);
+    const Scalar accel = utils::dot(acceleration, normal);
+    const Scalar discriminant = speed * speed - 2.f * accel * depth;
+    if (speed <= 0.f || discriminant < 0.f) return false;
+
+    // Smallest t > 0 with depth - speed * t + accel * t^2 / 2 = 0
+    const Scalar t = 2.f * depth / (speed + utils::sqrt(discriminant));
+    if (t > dt) return false;
+
+    const Vec2 contact_velocity = state.velocity - acceleration * t;
+    const Vec2 contact_position = state.position - state.velocity * t + Scalar(0.5f) * acceleration * t * t;
+    const Vec2 reflected = contact_velocity
+                                 - (1.f + RESTITUTION) * utils::dot(contact_velocity, normal) * normal;
+
+    state.position = contact_position + reflected * t + Scalar(0.5f) * acceleration * t * t;
+    state.velocity = reflected + acceleration * t;
+
+    // The field may push back in within t, keep the ball on the surface then
+    const Scalar inside = utils::dot(state.position - contact_position, normal);
+    if (inside > 0.f) state.position -= inside * normal;
+    return true;
+}
+
+}
+
+class RK45Ball : public Ball {
+private:
+    State state;
+    Scalar trial_step;
+public:
+    RK45Ball(Scalar radius, Vec2 init_position, Scalar init_speed, Scalar angle)
+        : Ball(radius, init_position, init_speed, angle)
+    {
+        state.position = position;
+        state.velocity = velocity;
+        trial_step     = deltaTime;
+    }
+
+    void updatePosition()
+    {
+        // Forces::accumulate leaves the local fields plus the interactions in acceleration
+        const Vec2 interaction = acceleration - Forces::at(state.position, state.velocity);
+        dormand_prince::advance(state, deltaTime, trial_step, interaction);
+        setShapePosition(state.position);
+    }
+
+    [[nodiscard]] Vec2 getPosition() const
+    {
+        return state.position;
+    }
+
+    [[nodiscard]] Vec2 getVelocity() const
+    {
+        return state.velocity;
+    }
+
+    [[nodiscard]] Scalar getSpeed() const noexcept
+    {
+        return utils::norm2f(state.velocity);
+    }
+
+    // Step size the next update starts with
+    [[nodiscard]] Scalar getTrialStep() const
+    {
+        return trial_step;
+    }
+
+    friend class CollisionSolver<RK45Ball>;
+};
+
+
+template<>
+inline void ParticleStore<RK45Ball>::updatePositions(size_t first, size_t last)
+{
+    const bool interacting = hasInteractions();
+    for (size_t i{first}; i < last; ++i) {
+        if (asleep[i]) continue;
+        State state{{x[i], y[i]}, {vx[i], vy[i]}};
+        const Vec2 interaction = interacting ? Vec2{ax[i], ay[i]} : Vec2{};
+        dormand_prince::advance(state, deltaTime, trial_step[i], interaction);
+        x[i]  = state.position.x;   y[i]  = state.position.y;
+        vx[i] = state.velocity.x;   vy[i] = state.velocity.y;
+    }
+}
+
+
+// Pair collisions are the RK4 impulses, borders and walls locate the contact in time
+template<>
+class CollisionSolver<RK45Ball> {
+    CollisionSolver() = default;
+    using RK4Collisions = CollisionSolver<RK4Ball>;
+
+    // Clamp and reflect like RK4 when the contact cannot be located
+    static void bounce(State& state, Vec2 normal, Scalar depth, Scalar dt) {
+        if (dormand_prince::bounceAtContact(state, normal, depth, dt)) return;
+        state.position -= depth * normal;
+        const Scalar speed = utils::dot(state.velocity, normal);
+        if (speed > 0.f) state.velocity -= (1.f + RESTITUTION) * speed * normal;
+    }
+
+    static void bounceOffBorder(State& state, const Scalar radius, const int windowWidth, const int windowHeight,
+                                const Scalar dt) {
+        if (state.position.x + radius > windowWidth) {
+            bounce(state, {1.f, 0.f}, state.position.x + radius - windowWidth, dt);
+        } else if (state.position.x - radius < 0) {
+            bounce(state, {-1.f, 0.f}, radius - state.position.x, dt);
+        }
+
+        if (state.position.y + radius > windowHeight) {
+            bounce(state, {0.f, 1.f}, state.position.y + radius - windowHeight, dt);
+            state.velocity.x *= FRICTION_COEFFICIENT;   // Apply friction on ground
+        } else if (state.position.y - radius < 0) {
+            bounce(state, {0.f, -1.f}, radius - state.position.y, dt);
+        }
+    }
+
+    static bool bounceOffWall(State& state, const Scalar radius, const Wall& wall, const Scalar dt) {
+        const Vec2 ball_to_closest = closestPointToWall(state.position, wall) - state.position;
+        const Scalar dist = utils::norm2f(ball_to_closest);
+        if (dist >= radius) return false;
+
+        bounce(state, utils::normalize(ball_to_closest), radius - dist, dt);
+        state.velocity *= wall.WALL_FRICTION;
+        return true;
+    }
+
+    static State loadState(const ParticleStore<RK45Ball>& balls, size_t i) {
+        return {{balls.x[i], balls.y[i]}, {balls.vx[i], balls.vy[i]}};
+    }
+
+    static void storeState(ParticleStore<RK45Ball>& balls, size_t i, const State& state) {
+        balls.x[i]  = state.position.x;    balls.y[i]  = state.position.y;
+        balls.vx[i] = state.velocity.x;    balls.vy[i] = state.velocity.y;
+    }
+
+public:
+    static void handleBorderCollision(RK45Ball& ball, const int& windowWidth, const int& windowHeight){
+        bounceOffBorder(ball.state, ball.radius, windowWidth, windowHeight, ball.deltaTime);
+        ball.setShapePosition(ball.state.position);
+    }
+
+    static bool resolvePairCollision(RK45Ball& ballA, RK45Ball& ballB) {
+        if (RK4Collisions::collide(ballA.state, ballB.state, ballA.radius, ballB.radius)) {
+            ballA.setShapePosition(ballA.state.position);
+            ballB.setShapePosition(ballB.state.position);
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(RK45Ball& ball, const Wall& wall) {
+        if (bounceOffWall(ball.state, ball.radius, wall, ball.deltaTime)) {
+            ball.setShapePosition(ball.state.position);
+        }
+    }
+
+    // Structure-of-arrays versions, i and j index into the store
+    static void handleBorderCollision(ParticleStore<RK45Ball>& balls, size_t i, const int& windowWidth, const int& windowHeight){
+        State state = loadState(balls, i);
+        bounceOffBorder(state, balls.radius[i], windowWidth, windowHeight, balls.getStepSize());
+        storeState(balls, i, state);
+    }
+
+    static bool resolvePairCollision(ParticleStore<RK45Ball>& balls, size_t i, size_t j) {
+        State stateA = loadState(balls, i);
+        State stateB = loadState(balls, j);
+        if (RK4Collisions::collide(stateA, stateB, balls.radius[i], balls.radius[j])) {
+            storeState(balls, i, stateA);
+            storeState(balls, j, stateB);
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(ParticleStore<RK45Ball>& balls, size_t i, const Wall& wall) {
+        State state = loadState(balls, i);
+        if (bounceOffWall(state, balls.radius[i], wall, balls.getStepSize())) {
+            storeState(balls, i, state);
+        }
+    }
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "../utils/fixed.h"
+
+// Number type of the physics, chosen once per build:
+//   default                float, the fast one
+//   PHYSICS_SCALAR_DOUBLE  double, for long runs and large worlds
+//   PHYSICS_SCALAR_FIXED   utils::Fixed, bit-identical results on every machine (lockstep, replays)
+// Ball state, collisions, forces and snapshots use Scalar and Vec2. Rendering, input and the
+// frame clock stay in float and convert at the boundary.
+#if defined(PHYSICS_SCALAR_DOUBLE)
+using Scalar = double;
+#elif defined(PHYSICS_SCALAR_FIXED)
+using Scalar = utils::Fixed;
+#else
+using Scalar = float;
+#endif
+
+using Vec2 = sf::Vector2<Scalar>;
+
+inline const char* scalarName()
+{
+#if defined(PHYSICS_SCALAR_DOUBLE)
+    return "double";
+#elif defined(PHYSICS_SCALAR_FIXED)
+    return "fixed";
+#else
+    return "float";
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+// Fixed timestep scheduler
+// Frame time is accumulated and consumed in whole physics steps, so the simulation
+// runs at the same rate whatever the render frame rate is. Each step is split into
+// a number of substeps (smaller dt, more collision passes) for stable stacking.
+class FixedStepScheduler {
+private:
+    float step_size;
+    uint32_t substeps;
+    uint32_t max_steps_per_frame;
+    float accumulator   = 0.f;
+    uint64_t step_count = 0;
+
+public:
+    FixedStepScheduler(float step_rate = 120.f, uint32_t substeps = 1, uint32_t max_steps_per_frame = 8)
+        : step_size(1.f / step_rate),
+        substeps(std::max<uint32_t>(substeps, 1)),
+        max_steps_per_frame(std::max<uint32_t>(max_steps_per_frame, 1))
+    {}
+
+    // Run step() once for every whole physics step contained in the elapsed frame time.
+    // Returns how far the simulation is into the next step (0-1), used to interpolate rendering.
+    template <typename StepFn>
+    float advance(float frame_time, StepFn&& step)
+    {
+        // Drop time we cannot catch up with instead of spiralling after a long hitch
+        accumulator += std::min(frame_time, step_size * max_steps_per_frame);
+
+        while (accumulator >= step_size) {
+            step();
+            accumulator -= step_size;
+            ++step_count;
+        }
+        return accumulator / step_size;
+    }
+
+    [[nodiscard]] float getStepSize() const { return step_size;}
+    [[nodiscard]] float getSubstepSize() const { return step_size / substeps;}
+    [[nodiscard]] uint32_t getSubsteps() const { return substeps;}
+    [[nodiscard]] uint64_t getStepCount() const { return step_count;}
+    [[nodiscard]] float getSimulatedTime() const { return step_count * step_size;}
+
+    // Resume counting from a snapshot
+    void setStepCount(uint64_t count) { step_count = count;}
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "scheduler.h"
+
+// Runs the physics on its own thread, on its own fixed clock
+// step() is called once per physics step as the FixedStepScheduler hands them out, then publish()
+// once per batch of steps (copy the state out, e.g. into a TripleBuffer<RenderFrame>). Between
+// batches the thread sleeps until the next step is due, so a window waiting for vsync or a slow
+// frame never holds the physics back, and a slow step never holds the window back.
+// Everything the steps touch belongs to this thread while it runs: other threads post() a command
+// instead, it runs on this thread before the next batch.
+class SimulationThread {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::mutex mutex;
+    std::vector<std::function<void()>> commands, running_commands;
+
+    void runCommands()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.swap(running_commands);
+        }
+        for (auto& command : running_commands) command();
+        running_commands.clear();
+    }
+
+public:
+    SimulationThread() = default;
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+    ~SimulationThread() { stop();}
+
+    // scheduler, step and publish are used by the thread until stop returns
+    template <typename StepFn, typename PublishFn>
+    void start(FixedStepScheduler& scheduler, StepFn step, PublishFn publish)
+    {
+        stop();
+        running = true;
+        thread = std::thread([this, &scheduler, step = std::move(step), publish = std::move(publish)]() mutable {
+            Clock::time_point last = Clock::now();
+            while (running.load(std::memory_order_relaxed)) {
+                runCommands();
+
+                const Clock::time_point now = Clock::now();
+                const float elapsed = std::chrono::duration<float>(now - last).count();
+                last = now;
+                const uint64_t before = scheduler.getStepCount();
+                const float alpha = scheduler.advance(elapsed, step);
+                if (scheduler.getStepCount() != before) publish();
+
+                std::this_thread::sleep_for(std::chrono::duration<float>((1.f - alpha) * scheduler.getStepSize()));
+            }
+            runCommands();
+        });
+    }
+
+    // Finish the current batch and the commands posted so far, then join
+    void stop()
+    {
+        running = false;
+        if (thread.joinable()) thread.join();
+    }
+
+    // Run command on the simulation thread before its next batch of steps
+    void post(std::function<void()> command)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        commands.push_back(std::move(command));
+    }
+
+    [[nodiscard]] bool isRunning() const { return running;}
+};
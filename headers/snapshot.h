@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "verlet.h"
+#include "explicit_euler.h"
+#include "rk4.h"
+#include "rk45.h"
+#include "particles.h"
+#include "wall.h"
+#include "../utils/mapped_file.h"
+
+// Binary snapshot of a ParticleStore, its walls and the spawner RNG.
+//
+//   SnapshotHeader
+//   Scalar x[n], y[n]
+//   Scalar a[n], b[n]        prev_x/prev_y for Verlet, vx/vy otherwise
+//   Scalar radius[n]
+//   uint8  rgba[n][4]
+//   uint8  asleep[n]
+//   uint16 still_steps[n]
+//   Scalar anchor_x[n], anchor_y[n]
+//   Scalar trial_step[n]     adaptive integrators (RK45) only
+//   Scalar wall[walls][5]    start x, start y, length, width, incline in degrees
+//   char   rng[rng_size]     spawner state, RNG and lifetime ring (Spawner::getState)
+//
+// Everything a step reads is stored, so stepping a loaded snapshot gives the same balls
+// bit for bit as stepping on from where it was saved.
+// Arrays are raw native-endian Scalars so loading is a memory map plus one copy per array.
+// A snapshot only loads into a build with the same Scalar.
+struct SnapshotHeader {
+    char magic[4]        = {'E', 'V', 'R', 'S'};
+    uint32_t version     = 3;
+    uint32_t ball_type   = 0;
+    uint32_t wall_count  = 0;
+    uint64_t ball_count  = 0;
+    uint64_t step        = 0;       // physics steps completed when the snapshot was taken
+    double step_size     = 0.0;
+    uint32_t rng_size    = 0;
+    uint32_t scalar_type = 0;
+};
+
+class Snapshot {
+private:
+    Snapshot() = default;
+    static constexpr uint32_t VERSION = 3;
+
+    template <typename T>
+    static constexpr uint32_t ballType() {
+        if constexpr (std::is_same_v<T, VerletBall>) return 1;
+        if constexpr (std::is_same_v<T, EulerBall>) return 2;
+        if constexpr (std::is_same_v<T, RK4Ball>) return 3;
+        if constexpr (std::is_same_v<T, RK45Ball>) return 4;
+        if constexpr (std::is_same_v<T, ImplicitEulerBall>) return 5;
+        return 0;
+    }
+
+    static constexpr uint32_t scalarType() {
+        if constexpr (std::is_same_v<Scalar, float>) return 1;
+        if constexpr (std::is_same_v<Scalar, double>) return 2;
+        if constexpr (std::is_same_v<Scalar, utils::Fixed>) return 3;
+        return 0;
+    }
+
+    template <typename Value>
+    static bool write(std::FILE* file, const Value* values, size_t count) {
+        return count == 0 || std::fwrite(values, sizeof(Value), count, file) == count;
+    }
+
+    template <typename Value>
+    static void copy(std::vector<Value>& values, const unsigned char*& cursor, size_t count) {
+        values.resize(count);
+        if (count > 0) std::memcpy(values.data(), cursor, count * sizeof(Value));
+        cursor += count * sizeof(Value);
+    }
+
+public:
+    template <typename T>
+    static bool save(const std::string& path, const ParticleStore<T>& balls, const std::vector<Wall>& walls,
+                     uint64_t step, const std::string& rng_state) {
+        constexpr bool position_based = ParticleStore<T>::position_based;
+        constexpr bool adaptive       = ParticleStore<T>::adaptive;
+        const size_t count = balls.size();
+
+        SnapshotHeader header;
+        header.version    = VERSION;
+        header.ball_type  = ballType<T>();
+        header.wall_count = static_cast<uint32_t>(walls.size());
+        header.ball_count = count;
+        header.step       = step;
+        header.step_size  = static_cast<double>(balls.getStepSize());
+        header.rng_size   = static_cast<uint32_t>(rng_state.size());
+        header.scalar_type = scalarType();
+
+        std::vector<Scalar> wall_data;
+        wall_data.reserve(5 * walls.size());
+        for (const auto& wall : walls) {
+            const Vec2 start = wall.getStartingPoint();
+            wall_data.insert(wall_data.end(), {start.x, start.y, wall.getLength(), wall.getWidth(), wall.getInclineDegrees()});
+        }
+
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+
+        static_assert(sizeof(sf::Color) == 4, "colors are stored as 4 bytes");
+        bool ok = write(file, &header, 1)
+               && write(file, balls.x.data(), count) && write(file, balls.y.data(), count)
+               && write(file, position_based ? balls.prev_x.data() : balls.vx.data(), count)
+               && write(file, position_based ? balls.prev_y.data() : balls.vy.data(), count)
+               && write(file, balls.radius.data(), count)
+               && write(file, balls.color.data(), count)
+               && write(file, balls.asleep.data(), count)
+               && write(file, balls.still_steps.data(), count)
+               && write(file, balls.anchor_x.data(), count) && write(file, balls.anchor_y.data(), count)
+               && (!adaptive || write(file, balls.trial_step.data(), count))
+               && write(file, wall_data.data(), wall_data.size())
+               && write(file, rng_state.data(), rng_state.size());
+        ok = (std::fclose(file) == 0) && ok;
+        return ok;
+    }
+
+    // Replaces the content of balls and walls. Fails without touching them if the file
+    // is missing, truncated or holds another ball type.
+    template <typename T>
+    static bool load(const std::string& path, ParticleStore<T>& balls, std::vector<Wall>& walls,
+                     uint64_t& step, std::string& rng_state) {
+        constexpr bool position_based = ParticleStore<T>::position_based;
+        constexpr bool adaptive       = ParticleStore<T>::adaptive;
+
+        utils::MappedFile file(path);
+        if (!file.isOpen() || file.getSize() < sizeof(SnapshotHeader)) return false;
+
+        SnapshotHeader header;
+        std::memcpy(&header, file.getData(), sizeof(header));
+        if (std::memcmp(header.magic, SnapshotHeader().magic, 4) != 0 || header.version != VERSION
+            || header.ball_type != ballType<T>() || header.scalar_type != scalarType()) {
+            return false;
+        }
+
+        const size_t count = static_cast<size_t>(header.ball_count);
+        const size_t per_ball = (adaptive ? 8 : 7) * sizeof(Scalar) + sizeof(sf::Color) + sizeof(uint8_t) + sizeof(uint16_t);
+        const size_t expected = sizeof(SnapshotHeader) + count * per_ball
+                              + header.wall_count * 5 * sizeof(Scalar) + header.rng_size;
+        if (file.getSize() != expected) return false;
+
+        const unsigned char* cursor = file.getData() + sizeof(SnapshotHeader);
+        balls.setStepSize(Scalar(header.step_size));
+        copy(balls.x, cursor, count);
+        copy(balls.y, cursor, count);
+        copy(position_based ? balls.prev_x : balls.vx, cursor, count);
+        copy(position_based ? balls.prev_y : balls.vy, cursor, count);
+        copy(balls.radius, cursor, count);
+        copy(balls.color, cursor, count);
+        copy(balls.asleep, cursor, count);
+        copy(balls.still_steps, cursor, count);
+        copy(balls.anchor_x, cursor, count);
+        copy(balls.anchor_y, cursor, count);
+        if constexpr (adaptive) copy(balls.trial_step, cursor, count);
+        balls.saveRenderState();
+        balls.recountSleeping();
+        balls.resetHandles();
+
+        std::vector<Scalar> wall_data;
+        copy(wall_data, cursor, header.wall_count * 5);
+        walls.clear();
+        for (size_t i{0}; i < header.wall_count; ++i) {
+            const Scalar* w = &wall_data[5 * i];
+            walls.emplace_back(Vec2{w[0], w[1]}, w[2], w[3], w[4]);
+        }
+
+        rng_state.assign(reinterpret_cast<const char*>(cursor), header.rng_size);
+        step = header.step;
+        return true;
+    }
+};
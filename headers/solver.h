@@ -1,49 +1,725 @@
 #pragma once
 #include "verlet.h"
 #include "explicit_euler.h"
+#include "implicit_euler.h"
 #include "rk4.h"
+#include "rk45.h"
 #include "wall.h"
+#include "wall_tree.h"
+#include "ccd.h"
+#include "grid.h"
+#include "hierarchical_grid.h"
+#include "morton.h"
+#include "contacts.h"
+#include "sweep_and_prune.h"
+#include "particles.h"
+#include "thread_pool.h"
+#include "../utils/profiler.h"
+#include <atomic>
+#include <memory>
+#include <vector>
 
 const int width = 1000;
 const int height = 1000;
 
+enum class BroadPhase {
+    BruteForce,         // test every ball against every other ball, O(n^2)
+    Grid,               // uniform grid, only neighbouring cells are tested
+    ParallelGrid,       // uniform grid swept in column strips on a thread pool
+    SweepAndPrune,      // balls kept sorted along x, only overlapping x intervals are tested
+    HierarchicalGrid    // one grid level per radius class, for radii spread over orders of magnitude
+};
+
+inline const char* toString(BroadPhase mode) {
+    switch (mode) {
+        case BroadPhase::BruteForce:       return "brute force";
+        case BroadPhase::Grid:             return "grid";
+        case BroadPhase::ParallelGrid:     return "parallel grid";
+        case BroadPhase::SweepAndPrune:    return "sweep and prune";
+        case BroadPhase::HierarchicalGrid: return "hierarchical grid";
+    }
+    return "";
+}
+
+// How the uniform grid broadphases correct the touching pairs they find
+enum class ContactSolver {
+    GaussSeidel,    // pair by pair as the grid finds them, each correction sees the ones before
+    Colored,        // contacts split into colors without a shared ball, each color corrected in parallel
+    Jacobi          // every ball averages the corrections of all its contacts, from the same positions (Verlet)
+};
+
+inline const char* toString(ContactSolver mode) {
+    switch (mode) {
+        case ContactSolver::GaussSeidel: return "gauss-seidel";
+        case ContactSolver::Colored:     return "colored";
+        case ContactSolver::Jacobi:      return "jacobi";
+    }
+    return "";
+}
+
+// Pairs handed to the narrowphase by the broadphase, and how many of them were touching
+struct PairStats {
+    uint64_t tested    = 0;
+    uint64_t colliding = 0;
+};
+
 class Solver{
 private:
     Solver() = default;
     static const uint16_t MAX_ITERATIONS = 1;
-public:
-    template <typename T> 
-    static void resolveCollisions(std::vector<T>& balls, std::vector<Wall>& walls) {
-        for(size_t n{0}; n < MAX_ITERATIONS; ++n){
-            for (size_t i{0}; i < balls.size(); ++i) {
-                // Resolve border collisions
-                CollisionSolver<T>::handleBorderCollision(balls[i], width, height);
+    static inline BroadPhase broad_phase = BroadPhase::Grid;
+    static inline UniformGrid grid;
+    static inline SweepAndPrune sweep;
+    static inline HierarchicalGrid hierarchy;
+    static inline PairStats pair_stats;
+    static inline std::unique_ptr<ThreadPool> pool;
+    static const size_t BALLS_PER_TASK = 1024;
 
-                // Resolve ball-ball collisions
-                for (size_t j{i + 1}; j < balls.size(); ++j) {
-                    CollisionSolver<T>::resolvePairCollision(balls[i], balls[j]);
+    // Contact graph solvers
+    static inline ContactSolver contact_solver = ContactSolver::GaussSeidel;
+    static inline ContactGraph contacts;
+    static inline std::vector<std::vector<ContactGraph::Contact>> strip_contacts;
+    static inline std::vector<Scalar> jacobi_x, jacobi_y;
+    static inline Scalar jacobi_relaxation = 1.f;   // plain average at 1, up to ω contacts summed above
+    static const int COLUMNS_PER_STRIP   = 4;
+    static const size_t CONTACTS_PER_TASK = 2048;
+    static const size_t CONTACTS_PER_BALL = 3;      // a packed pile has 6 neighbours per ball, each contact shared by 2
+
+    // Continuous collisions, off by default
+    static inline bool continuous     = false;
+    static inline Scalar sweep_fraction = 1.f;      // of the radius, balls moving more per step are swept
+    static inline std::vector<uint32_t> fast_balls;
+    static inline uint64_t swept_hits = 0;
+
+    // Spatial reordering of the balls, off by default
+    static inline uint32_t reorder_interval = 0;
+    static inline uint32_t since_reorder    = 0;
+    static inline MortonOrder morton;
+    static inline std::vector<uint32_t> new_index;
+
+    static ThreadPool& threadPool() {
+        if (!pool) pool = std::make_unique<ThreadPool>();
+        return *pool;
+    }
+
+    // Uniform access to a std::vector of balls and a ParticleStore
+    template <typename T>
+    static Vec2 positionOf(const std::vector<T>& balls, size_t i) { return balls[i].getPosition();}
+    template <typename T>
+    static Vec2 positionOf(const ParticleStore<T>& balls, size_t i) { return balls.getPosition(i);}
+    template <typename T>
+    static Scalar radiusOf(const std::vector<T>& balls, size_t i) { return balls[i].radius;}
+    template <typename T>
+    static Scalar radiusOf(const ParticleStore<T>& balls, size_t i) { return balls.radius[i];}
+    template <typename T>
+    static bool isAsleep(const std::vector<T>&, size_t) { return false;}
+    template <typename T>
+    static bool isAsleep(const ParticleStore<T>& balls, size_t i) { return balls.asleep[i] != 0;}
+
+    template <typename T>
+    static void border(std::vector<T>& balls, size_t i) {
+        CollisionSolver<T>::handleBorderCollision(balls[i], width, height);
+    }
+    template <typename T>
+    static void border(ParticleStore<T>& balls, size_t i) {
+        CollisionSolver<T>::handleBorderCollision(balls, i, width, height);
+    }
+    template <typename T>
+    static bool pair(std::vector<T>& balls, size_t i, size_t j) {
+        return CollisionSolver<T>::resolvePairCollision(balls[i], balls[j]);
+    }
+    template <typename T>
+    static bool pair(ParticleStore<T>& balls, size_t i, size_t j) {
+        return CollisionSolver<T>::resolvePairCollision(balls, i, j);
+    }
+    // A fast ball wakes the sleeping ball it hits, a slow one is pushed out of it as if it were
+    // a wall. Otherwise the jitter of a pile keeps shaking its own sleeping balls awake.
+    template <typename T>
+    static bool sleeperPair(std::vector<T>& balls, size_t awake, size_t sleeper) {
+        return pair(balls, awake, sleeper);
+    }
+    template <typename T>
+    static bool sleeperPair(ParticleStore<T>& balls, size_t awake, size_t sleeper) {
+        if (balls.isMovingFast(awake)) {
+            balls.wake(sleeper);
+            return pair(balls, awake, sleeper);
+        }
+        const Scalar x = balls.x[sleeper], y = balls.y[sleeper];
+        if (!pair(balls, awake, sleeper)) return false;
+
+        // Hand the sleeper's share of the correction to the awake ball
+        balls.x[awake] -= balls.x[sleeper] - x;
+        balls.y[awake] -= balls.y[sleeper] - y;
+        balls.x[sleeper] = x;
+        balls.y[sleeper] = y;
+        if constexpr (!ParticleStore<T>::position_based) {
+            balls.vx[sleeper] = 0.f;
+            balls.vy[sleeper] = 0.f;
+        }
+        return true;
+    }
+    template <typename Balls>
+    static bool contact(Balls& balls, size_t i, size_t j) {
+        return isAsleep(balls, i) ? sleeperPair(balls, j, i)
+             : isAsleep(balls, j) ? sleeperPair(balls, i, j)
+             : pair(balls, i, j);
+    }
+    template <typename Balls>
+    static void countedPair(Balls& balls, size_t i, size_t j, PairStats& stats) {
+        // Two sleeping balls cannot have moved into each other
+        if (isAsleep(balls, i) && isAsleep(balls, j)) return;
+
+        ++stats.tested;
+        if (contact(balls, i, j)) ++stats.colliding;
+    }
+    template <typename T>
+    static void wall(std::vector<T>& balls, size_t i, const Wall& w) {
+        CollisionSolver<T>::resolveWallCollision(balls[i], w);
+    }
+    template <typename T>
+    static void wall(ParticleStore<T>& balls, size_t i, const Wall& w) {
+        CollisionSolver<T>::resolveWallCollision(balls, i, w);
+    }
+
+    // Only the particle store tracks resting balls. Sleepers next to an erased ball wake in the
+    // next updateSleep, so that step still runs.
+    template <typename T>
+    static bool allAsleep(const std::vector<T>&) { return false;}
+    template <typename T>
+    static bool allAsleep(const ParticleStore<T>& balls) {
+        return !balls.empty() && balls.getSleepingCount() == balls.size() && !balls.hasVacancies();
+    }
+    template <typename T>
+    static void updateSleep(std::vector<T>&) {}
+    template <typename T>
+    static void updateSleep(ParticleStore<T>& balls) { balls.updateSleep();}
+
+    // Every wall in a plain list, only the walls near the ball in a tree
+    template <typename Balls>
+    static void collideWalls(Balls& balls, size_t i, const std::vector<Wall>& layout) {
+        for (size_t j{0}; j < layout.size(); ++j) {
+            wall(balls, i, layout[j]);
+        }
+    }
+    template <typename Balls>
+    static void collideWalls(Balls& balls, size_t i, const WallTree& layout) {
+        layout.query(positionOf(balls, i), radiusOf(balls, i), [&balls, i](const Wall& w) { wall(balls, i, w); });
+    }
+
+    // Walls a sweep within reach of centre may touch
+    template <typename WallFn>
+    static void wallsNear(const std::vector<Wall>& layout, Vec2, Scalar, WallFn&& fn) {
+        for (const Wall& w : layout) fn(w);
+    }
+    template <typename WallFn>
+    static void wallsNear(const WallTree& layout, Vec2 centre, Scalar reach, WallFn&& fn) {
+        layout.query(centre, reach, fn);
+    }
+
+    // Continuous collisions, run before the discrete pass. A ball that moved more than sweep_fraction
+    // of its radius this step is swept back along its velocity, stopped at the first border, wall or
+    // ball it touched on the way and bounced there, instead of ending up behind it. Other balls count
+    // as standing where they are now, and only once the step is longer than both radii together
+    // (shorter steps cannot carry a ball past another one's centre). The rest of the step is
+    // dropped for the swept ball. Ball objects keep the discrete checks only.
+    template <typename T, typename Walls>
+    static void sweepFastBalls(std::vector<T>&, const Walls&) {}
+
+    template <typename T, typename Walls>
+    static void sweepFastBalls(ParticleStore<T>& balls, const Walls& layout) {
+        const Scalar dt = balls.getStepSize();
+        Scalar max_radius = 0.f;
+        fast_balls.clear();
+        for (size_t i{0}; i < balls.size(); ++i) {
+            max_radius = std::max(max_radius, balls.radius[i]);
+            if (balls.asleep[i]) continue;
+            const Vec2 step = balls.getVelocity(i) * dt;
+            const Scalar limit = sweep_fraction * balls.radius[i];
+            if (utils::dot(step, step) > limit * limit) fast_balls.push_back(static_cast<uint32_t>(i));
+        }
+        if (fast_balls.empty()) return;
+
+        grid.build(balls.size(), width, height, static_cast<float>(max_radius), [&balls](size_t i) { return balls.getPosition(i); });
+
+        constexpr size_t NO_BALL = SIZE_MAX;
+        for (const uint32_t i : fast_balls) {
+            const Vec2 velocity = balls.getVelocity(i);
+            const Vec2 step  = velocity * dt;
+            const Vec2 end   = balls.getPosition(i);
+            const Vec2 start = end - step;
+            const Scalar radius = balls.radius[i];
+
+            Vec2 normal;
+            size_t other = NO_BALL;
+            Scalar hit = ccd::sweepBorder(start, step, radius, width, height, normal);
+
+            wallsNear(layout, start + Scalar(0.5f) * step, Scalar(0.5f) * utils::norm2f(step) + radius, [&](const Wall& w) {
+                Vec2 wall_normal;
+                const Scalar t = ccd::sweepWall(start, step, radius, w, wall_normal);
+                if (t < hit) {
+                    hit    = t;
+                    normal = wall_normal;
                 }
+            });
 
-                // Resolve ball-wall collisions
-                for (size_t j{0}; j < walls.size(); ++j) {
-                    CollisionSolver<T>::resolveWallCollision(balls[i], walls[j]);
+            const Scalar length = utils::norm2f(step);
+            const Scalar margin = radius + max_radius;
+            grid.forEachInBox(static_cast<float>(std::min(start.x, end.x) - margin),
+                              static_cast<float>(std::min(start.y, end.y) - margin),
+                              static_cast<float>(std::max(start.x, end.x) + margin),
+                              static_cast<float>(std::max(start.y, end.y) + margin),
+                              [&](uint32_t j) {
+                if (j == i || length <= sweep_fraction * (radius + balls.radius[j])) return;
+                Vec2 ball_normal;
+                const Scalar t = ccd::sweepCircle(start, step, radius + balls.radius[j], balls.getPosition(j), ball_normal);
+                if (t < hit) {
+                    hit    = t;
+                    normal = ball_normal;
+                    other  = j;
                 }
+            });
+            if (hit == ccd::NO_HIT) continue;
+            ++swept_hits;
+
+            balls.x[i] = start.x + step.x * hit;
+            balls.y[i] = start.y + step.y * hit;
+            if (other == NO_BALL) {
+                const Scalar speed = utils::dot(velocity, normal);
+                balls.setVelocity(i, speed > 0.f ? velocity - (1.f + RESTITUTION) * speed * normal : velocity);
+                continue;
+            }
+
+            // Same impulse as the velocity based pair collisions
+            if (balls.asleep[other]) balls.wake(other);
+            const Vec2 other_velocity = balls.getVelocity(other);
+            const Scalar speed = utils::dot(velocity - other_velocity, normal);
+            if (speed <= 0.f) {
+                balls.setVelocity(i, velocity);
+                continue;
             }
+            const Scalar min_dist = radius + balls.radius[other];
+            const Scalar impulse  = (1.f + RESTITUTION) * speed;
+            balls.setVelocity(i, velocity - normal * (impulse * balls.radius[other] / min_dist));
+            balls.setVelocity(other, other_velocity + normal * (impulse * radius / min_dist));
         }
     }
 
-    template <typename T> 
-    static void resolveCollisions(std::vector<T>& balls) {
+    // Run fn(i) for every ball, split into chunks on the thread pool in parallel mode
+    template <typename Fn>
+    static void forEachBall(size_t count, Fn&& fn) {
+        if (broad_phase != BroadPhase::ParallelGrid) {
+            for (size_t i{0}; i < count; ++i) fn(i);
+            return;
+        }
+        const size_t tasks = (count + BALLS_PER_TASK - 1) / BALLS_PER_TASK;
+        threadPool().parallelFor(tasks, [&](size_t task) {
+            const size_t last = std::min(count, (task + 1) * BALLS_PER_TASK);
+            for (size_t i{task * BALLS_PER_TASK}; i < last; ++i) fn(i);
+        });
+    }
+
+    template <typename Balls>
+    static void resolveGridCollisions(Balls& balls) {
+        buildGrid(balls);
+
+        if (broad_phase != BroadPhase::ParallelGrid) {
+            grid.forEachPair([&balls](uint32_t i, uint32_t j) { countedPair(balls, i, j, pair_stats); });
+            return;
+        }
+
+        // Pairs of a strip only touch its own columns and one column on each side.
+        // With strips at least 2 columns wide, all even strips (then all odd strips)
+        // move disjoint sets of balls and can run at the same time.
+        ThreadPool& threads = threadPool();
+        const int columns      = grid.getColumns();
+        const int strip_width  = std::max(2, columns / static_cast<int>(2 * threads.size()));
+        const int strip_count  = (columns + strip_width - 1) / strip_width;
+
+        std::atomic<uint64_t> tested{0}, colliding{0};
+        for (int parity{0}; parity < 2; ++parity) {
+            const size_t strips = static_cast<size_t>((strip_count - parity + 1) / 2);
+            threads.parallelFor(strips, [&](size_t k) {
+                const int first = (2 * static_cast<int>(k) + parity) * strip_width;
+                const int last  = std::min(columns, first + strip_width);
+                PairStats strip;
+                grid.forEachPairInColumns(first, last, [&balls, &strip](uint32_t i, uint32_t j) {
+                    countedPair(balls, i, j, strip);
+                });
+                tested    += strip.tested;
+                colliding += strip.colliding;
+            });
+        }
+        pair_stats.tested    += tested;
+        pair_stats.colliding += colliding;
+    }
+
+    // Touching pairs of the grid into contacts. Strips of columns are searched in parallel and
+    // appended in strip order, so the contacts come out the same whatever the thread count.
+    template <typename Balls>
+    static void gatherContacts(Balls& balls) {
+        const int strip_count = (grid.getColumns() + COLUMNS_PER_STRIP - 1) / COLUMNS_PER_STRIP;
+        if (strip_contacts.size() < static_cast<size_t>(strip_count)) strip_contacts.resize(strip_count);
+
+        std::atomic<uint64_t> tested{0};
+        threadPool().parallelFor(static_cast<size_t>(strip_count), [&](size_t k) {
+            std::vector<ContactGraph::Contact>& found = strip_contacts[k];
+            found.clear();
+            const int first = static_cast<int>(k) * COLUMNS_PER_STRIP;
+            const int last  = std::min(grid.getColumns(), first + COLUMNS_PER_STRIP);
+            uint64_t strip_tested = 0;
+            grid.forEachPairInColumns(first, last, [&](uint32_t i, uint32_t j) {
+                if (isAsleep(balls, i) && isAsleep(balls, j)) return;
+                ++strip_tested;
+                const Vec2 delta = positionOf(balls, j) - positionOf(balls, i);
+                const Scalar reach = radiusOf(balls, i) + radiusOf(balls, j);
+                if (delta.x * delta.x + delta.y * delta.y < reach * reach) found.push_back({i, j});
+            });
+            tested += strip_tested;
+        });
+
+        contacts.clear();
+        for (int k{0}; k < strip_count; ++k) contacts.append(strip_contacts[k]);
+        pair_stats.tested += tested;
+    }
+
+    // Contacts of one color share no ball and are corrected in parallel, colors one after the other
+    template <typename Balls>
+    static void resolveColoredContacts(Balls& balls) {
+        contacts.color(balls.size());
+        std::atomic<uint64_t> colliding{0};
+        for (size_t c{0}; c < contacts.getBatchCount(); ++c) {
+            const ContactGraph::Contact* batch = contacts.batchBegin(c);
+            const size_t size = contacts.batchSize(c);
+            if (contacts.isSerialBatch(c) || size <= CONTACTS_PER_TASK) {
+                uint64_t touching = 0;
+                for (size_t k{0}; k < size; ++k) touching += contact(balls, batch[k].a, batch[k].b);
+                colliding += touching;
+                continue;
+            }
+            const size_t tasks = (size + CONTACTS_PER_TASK - 1) / CONTACTS_PER_TASK;
+            threadPool().parallelFor(tasks, [&](size_t task) {
+                const size_t last = std::min(size, (task + 1) * CONTACTS_PER_TASK);
+                uint64_t touching = 0;
+                for (size_t k{task * CONTACTS_PER_TASK}; k < last; ++k) touching += contact(balls, batch[k].a, batch[k].b);
+                colliding += touching;
+            });
+        }
+        pair_stats.colliding += colliding;
+    }
+
+    // Every ball moves by the average of the corrections its contacts ask for, all computed from
+    // the positions before the pass, so every ball is independent. The average is scaled by the
+    // relaxation (capped at the plain sum): averaged alone, one pass per step lets a pile sink
+    // into itself. A sleeping ball stays put and the awake ball takes the whole correction, as in sleeperPair.
+    template <typename Balls>
+    static void resolveJacobiContacts(Balls& balls) { resolveColoredContacts(balls);}
+
+    static void resolveJacobiContacts(ParticleStore<VerletBall>& balls) {
+        // Fast balls wake the sleepers they hit first, one after the other
+        for (size_t k{0}; k < contacts.size(); ++k) {
+            const uint32_t a = contacts[k].a, b = contacts[k].b;
+            if (balls.asleep[a] != balls.asleep[b]) {
+                const uint32_t awake = balls.asleep[a] ? b : a, sleeper = balls.asleep[a] ? a : b;
+                if (balls.isMovingFast(awake)) balls.wake(sleeper);
+            }
+        }
+        contacts.buildAdjacency(balls.size());
+        jacobi_x.assign(balls.size(), 0.f);
+        jacobi_y.assign(balls.size(), 0.f);
+
+        const size_t tasks = (balls.size() + BALLS_PER_TASK - 1) / BALLS_PER_TASK;
+        threadPool().parallelFor(tasks, [&](size_t task) {
+            const size_t last = std::min(balls.size(), (task + 1) * BALLS_PER_TASK);
+            for (size_t i{task * BALLS_PER_TASK}; i < last; ++i) {
+                if (balls.asleep[i]) continue;
+                Scalar sum_x = 0.f, sum_y = 0.f;
+                uint32_t count = 0;
+                for (const uint32_t* j = contacts.neighboursBegin(i); j != contacts.neighboursEnd(i); ++j) {
+                    const Scalar dx = balls.x[*j] - balls.x[i], dy = balls.y[*j] - balls.y[i];
+                    const Scalar min_dist = balls.radius[i] + balls.radius[*j];
+                    const Scalar dist = utils::sqrt(dx * dx + dy * dy);
+                    if (dist <= 0.f || dist >= min_dist) continue;
+
+                    const Scalar share = balls.asleep[*j] ? 1.f : balls.radius[*j] / min_dist;
+                    const Scalar push  = RESTITUTION * (min_dist - dist) * share / dist;
+                    sum_x -= dx * push;
+                    sum_y -= dy * push;
+                    ++count;
+                }
+                if (count == 0) continue;
+                const Scalar scale = std::min(jacobi_relaxation, static_cast<Scalar>(count)) / count;
+                jacobi_x[i] = sum_x * scale;
+                jacobi_y[i] = sum_y * scale;
+            }
+        });
+        for (size_t i{0}; i < balls.size(); ++i) {
+            balls.x[i] += jacobi_x[i];
+            balls.y[i] += jacobi_y[i];
+        }
+        pair_stats.colliding += contacts.size();
+    }
+
+    template <typename Balls>
+    static void resolveContactGraph(Balls& balls) {
+        buildGrid(balls);
+        gatherContacts(balls);
+        if (contact_solver == ContactSolver::Jacobi) resolveJacobiContacts(balls);
+        else resolveColoredContacts(balls);
+    }
+
+    template <typename Balls>
+    static void resolveSweepCollisions(Balls& balls) {
+        sweep.update(balls.size(),
+                     [&balls](size_t i) { return positionOf(balls, i); },
+                     [&balls](size_t i) { return radiusOf(balls, i); });
+        sweep.forEachPair([&balls](uint32_t i, uint32_t j) { countedPair(balls, i, j, pair_stats); });
+    }
+
+    template <typename Balls>
+    static void resolveHierarchicalCollisions(Balls& balls) {
+        hierarchy.build(balls.size(), width, height,
+                        [&balls](size_t i) { return positionOf(balls, i); },
+                        [&balls](size_t i) { return radiusOf(balls, i); });
+        hierarchy.forEachPair([&balls](uint32_t i, uint32_t j) { countedPair(balls, i, j, pair_stats); });
+    }
+
+    template <typename Balls, typename Walls>
+    static void solve(Balls& balls, const Walls& layout) {
+        if (!beginCollisions(balls, layout)) return;
+
         for(size_t n{0}; n < MAX_ITERATIONS; ++n){
+            if (broad_phase != BroadPhase::BruteForce) {
+                // Resolve border collisions
+                {
+                    PROFILE_SCOPE("border collisions");
+                    forEachBall(balls.size(), [&balls](size_t i) {
+                        if (!isAsleep(balls, i)) border(balls, i);
+                    });
+                }
+
+                // Resolve ball-ball collisions
+                {
+                    PROFILE_SCOPE("pair collisions");
+                    resolvePairs(balls);
+                }
+
+                // Resolve ball-wall collisions
+                PROFILE_SCOPE("wall collisions");
+                forEachBall(balls.size(), [&balls, &layout](size_t i) {
+                    if (!isAsleep(balls, i)) collideWalls(balls, i, layout);
+                });
+                continue;
+            }
+
+            // Border, pair and wall collisions are interleaved per ball here
+            PROFILE_SCOPE("brute force");
             for (size_t i{0}; i < balls.size(); ++i) {
                 // Resolve border collisions
-                CollisionSolver<T>::handleBorderCollision(balls[i], width, height);
+                const bool awake = !isAsleep(balls, i);
+                if (awake) border(balls, i);
 
                 // Resolve ball-ball collisions
                 for (size_t j{i + 1}; j < balls.size(); ++j) {
-                    CollisionSolver<T>::resolvePairCollision(balls[i], balls[j]);
+                    countedPair(balls, i, j, pair_stats);
                 }
+
+                // Resolve ball-wall collisions
+                if (awake) collideWalls(balls, i, layout);
             }
         }
+        endCollisions(balls);
+    }
+
+public:
+    static void setBroadPhase(BroadPhase mode) { broad_phase = mode;}
+    [[nodiscard]] static BroadPhase getBroadPhase() { return broad_phase;}
+    [[nodiscard]] static const HierarchicalGrid& getHierarchy() { return hierarchy;}
+
+    // Counts of the last resolveCollisions call, tested / colliding is the pruning efficiency
+    [[nodiscard]] static const PairStats& getPairStats() { return pair_stats;}
+
+    // Contact solving of Grid and ParallelGrid. Jacobi only applies to ParticleStore<VerletBall>,
+    // the other ball types fall back to colored contacts.
+    static void setContactSolver(ContactSolver mode) { contact_solver = mode;}
+    [[nodiscard]] static ContactSolver getContactSolver() { return contact_solver;}
+    // Over-relaxation of Jacobi: a ball moves by min(ω, contacts) / contacts times the sum of its
+    // corrections, 1 (the default) averages them. Piles settle in fewer steps above 1, up to about 6
+    // (contacts of a ball in a packed pile), at the risk of jitter.
+    static void setJacobiRelaxation(Scalar omega) { jacobi_relaxation = std::max(omega, Scalar(1));}
+    [[nodiscard]] static Scalar getJacobiRelaxation() { return jacobi_relaxation;}
+
+    // Sweep balls that move more than fraction of their radius per step so that they cannot pass
+    // through walls and other balls (ParticleStore only)
+    static void setContinuous(bool enabled, Scalar fraction = 1.f) {
+        continuous     = enabled;
+        sweep_fraction = fraction;
+    }
+    [[nodiscard]] static bool isContinuous() { return continuous;}
+    // Balls stopped by a continuous collision in the last resolveCollisions call
+    [[nodiscard]] static uint64_t getSweptHits() { return swept_hits;}
+
+    // Sort the balls of a ParticleStore along a Z curve on the next call of resolveCollisions and
+    // then every steps calls, 0 keeps them in spawn order. Indices change, handles stay valid.
+    static void setReorderInterval(uint32_t steps) {
+        reorder_interval = steps;
+        since_reorder    = steps;
+    }
+    [[nodiscard]] static uint32_t getReorderInterval() { return reorder_interval;}
+
+    // Sort the balls by Morton code now, so that balls close in space are close in memory.
+    // Plain vectors of balls are left alone, nothing outside names them but their index.
+    template <typename T>
+    static void reorderParticles(std::vector<T>&) {}
+
+    template <typename T>
+    static void reorderParticles(ParticleStore<T>& balls) {
+        const std::vector<uint32_t>& order = morton.sort(balls.size(), width, height,
+                                                         [&balls](size_t i) { return balls.getPosition(i);});
+        balls.reorder(order);
+
+        // The sweep keeps its sorted order between steps by index
+        new_index.resize(order.size());
+        for (size_t k{0}; k < order.size(); ++k) new_index[order[k]] = static_cast<uint32_t>(k);
+        sweep.renumber(new_index);
+    }
+
+    // The phases of resolveCollisions one at a time, for callers that schedule them themselves
+    // (StepGraph): beginCollisions, resolveBorders over every ball, resolvePairs (or buildGrid
+    // then resolveGridColumns over strips of columns), resolveWalls over every ball, endCollisions.
+    // Disjoint ranges of balls may run on different threads, and so may strips of columns at
+    // least 2 apart, as in BroadPhase::ParallelGrid. Brute force runs the three passes one
+    // after the other here rather than interleaved per ball.
+
+    // Reordering and continuous collisions. False when nothing is left to resolve this step,
+    // the other phases are then skipped, endCollisions included.
+    template <typename Balls, typename Walls>
+    static bool beginCollisions(Balls& balls, const Walls& layout) {
+        pair_stats = {};
+        swept_hits = 0;
+        if (reorder_interval > 0 && ++since_reorder >= reorder_interval) {
+            PROFILE_SCOPE("reordering");
+            since_reorder = 0;
+            reorderParticles(balls);
+        }
+        // A settled scene has nothing left to resolve until a new ball shows up
+        if (allAsleep(balls)) return false;
+
+        if (continuous) {
+            PROFILE_SCOPE("continuous collisions");
+            sweepFastBalls(balls, layout);
+        }
+        return true;
+    }
+
+    template <typename Balls>
+    static void resolveBorders(Balls& balls, size_t first, size_t last) {
+        for (size_t i{first}; i < last; ++i) {
+            if (!isAsleep(balls, i)) border(balls, i);
+        }
+    }
+
+    // Every pair through the current broadphase and contact solver
+    template <typename Balls>
+    static void resolvePairs(Balls& balls) {
+        if (broad_phase == BroadPhase::BruteForce) {
+            for (size_t i{0}; i < balls.size(); ++i) {
+                for (size_t j{i + 1}; j < balls.size(); ++j) countedPair(balls, i, j, pair_stats);
+            }
+        }
+        else if (broad_phase == BroadPhase::SweepAndPrune) resolveSweepCollisions(balls);
+        else if (broad_phase == BroadPhase::HierarchicalGrid) resolveHierarchicalCollisions(balls);
+        else if (contact_solver != ContactSolver::GaussSeidel) resolveContactGraph(balls);
+        else resolveGridCollisions(balls);
+    }
+
+    // Bucket the balls into the uniform grid, cells fit the largest ball. Returns the column count.
+    template <typename Balls>
+    static int buildGrid(Balls& balls) {
+        Scalar max_radius = 0.f;
+        for (size_t i{0}; i < balls.size(); ++i) {
+            max_radius = std::max(max_radius, radiusOf(balls, i));
+        }
+        grid.build(balls.size(), width, height, static_cast<float>(max_radius),
+                   [&balls](size_t i) { return positionOf(balls, i); });
+        return grid.getColumns();
+    }
+
+    // Gauss-Seidel pairs of the grid columns [first, last), counted into the returned stats
+    // (add them up for endCollisions)
+    template <typename Balls>
+    [[nodiscard]] static PairStats resolveGridColumns(Balls& balls, int first, int last) {
+        PairStats strip;
+        grid.forEachPairInColumns(first, last, [&balls, &strip](uint32_t i, uint32_t j) {
+            countedPair(balls, i, j, strip);
+        });
+        return strip;
+    }
+
+    template <typename Balls, typename Walls>
+    static void resolveWalls(Balls& balls, const Walls& layout, size_t first, size_t last) {
+        for (size_t i{first}; i < last; ++i) {
+            if (!isAsleep(balls, i)) collideWalls(balls, i, layout);
+        }
+    }
+
+    // Pairs counted by the caller (resolveGridColumns) join getPairStats, then sleep is updated
+    template <typename Balls>
+    static void endCollisions(Balls& balls, const PairStats& counted = {}) {
+        pair_stats.tested    += counted.tested;
+        pair_stats.colliding += counted.colliding;
+        updateSleep(balls);
+    }
+
+    // Size the scratch buffers for ball_count balls up front, so that steps with up to that many
+    // balls (and a packed pile's worth of contacts) do not allocate
+    static void reserve(size_t ball_count) {
+        grid.reserve(ball_count);
+        fast_balls.reserve(ball_count);
+        new_index.reserve(ball_count);
+        jacobi_x.reserve(ball_count);
+        jacobi_y.reserve(ball_count);
+        contacts.reserve(ball_count, CONTACTS_PER_BALL * ball_count);
+
+        // Cells are at least a pixel wide
+        const size_t strip_count = (width + COLUMNS_PER_STRIP - 1) / COLUMNS_PER_STRIP;
+        if (strip_contacts.size() < strip_count) strip_contacts.resize(strip_count);
+        for (auto& found : strip_contacts) found.reserve(CONTACTS_PER_BALL * ball_count / strip_count);
+    }
+
+    // Number of threads used by BroadPhase::ParallelGrid, defaults to the core count
+    static void setThreadCount(size_t thread_count) { pool = std::make_unique<ThreadPool>(thread_count);}
+    [[nodiscard]] static size_t getThreadCount() { return threadPool().size();}
+
+    template <typename T>
+    static void resolveCollisions(std::vector<T>& balls, std::vector<Wall>& walls) {
+        solve(balls, walls);
+    }
+
+    template <typename T>
+    static void resolveCollisions(std::vector<T>& balls) {
+        std::vector<Wall> no_walls;
+        solve(balls, no_walls);
+    }
+
+    template <typename T>
+    static void resolveCollisions(ParticleStore<T>& balls, std::vector<Wall>& walls) {
+        solve(balls, walls);
+    }
+
+    template <typename T>
+    static void resolveCollisions(ParticleStore<T>& balls) {
+        std::vector<Wall> no_walls;
+        solve(balls, no_walls);
+    }
+
+    // Same with the walls baked into a WallTree, for layouts with many walls
+    template <typename T>
+    static void resolveCollisions(std::vector<T>& balls, const WallTree& walls) {
+        solve(balls, walls);
+    }
+
+    template <typename T>
+    static void resolveCollisions(ParticleStore<T>& balls, const WallTree& walls) {
+        solve(balls, walls);
     }
-};
\ No newline at end of file
+};
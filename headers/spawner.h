@@ -0,0 +1,136 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "particles.h"
+#define HAVE_SFML
+#include "../utils/random.h"
+
+inline sf::Color getRainbow(float t)
+{
+    const float r = sin(t);
+    const float g = sin(t + 0.33f * 2.0f * PI_f);
+    const float b = sin(t + 0.66f * 2.0f * PI_f);
+    return {static_cast<uint8_t>(255.0f * r * r),
+            static_cast<uint8_t>(255.0f * g * g),
+            static_cast<uint8_t>(255.0f * b * b)};
+}
+
+// Uniform Scalar in [min, max) for spawning. Fixed builds take the raw engine bits as the fraction of
+// a Q32.32 number, integer arithmetic only, so the balls are the same on every platform;
+// uniform_real_distribution is implementation-defined. Float and double keep the distribution.
+inline Scalar randomScalar(utils::Random& random, float min, float max)
+{
+#if defined(PHYSICS_SCALAR_FIXED)
+    return Scalar(min) + (Scalar(max) - Scalar(min)) * utils::Fixed::fromRaw(random.nextBits());
+#else
+    return random.generateRandomFloat(min, max);
+#endif
+}
+
+// Emits a stream of balls from a fixed point, driven by the physics step count rather than
+// a wall clock so that the same seed always produces the same balls on the same steps.
+// With a lifetime every ball is erased again that many steps after it was spawned.
+class Spawner {
+private:
+    utils::Random randomizer;
+
+    // Live spawned balls, oldest first, in a ring of max_balls entries
+    struct Spawned {
+        ParticleHandle handle;
+        uint64_t step;
+    };
+    std::vector<Spawned> spawned;
+    size_t oldest = 0, spawned_count = 0;
+    uint64_t despawned = 0;
+
+    template <typename T>
+    void despawnOldest(ParticleStore<T>& balls)
+    {
+        if (balls.erase(spawned[oldest].handle)) ++despawned;
+        oldest = (oldest + 1) % spawned.size();
+        --spawned_count;
+    }
+public:
+    sf::Vector2f position{40.f, 150.f};
+    float speed          = 10.f;        // Ball speed in m/s
+    float angle          = 0.f;
+    float min_radius     = 2.f;
+    float max_radius     = 25.f;
+    uint32_t interval    = 3;           // physics steps between two spawns
+    uint32_t burst       = 1;           // balls per spawn, stacked downwards from position
+    uint32_t max_balls   = 1200;
+    uint32_t lifetime    = 0;           // physics steps a ball lives, 0 = forever
+
+    explicit Spawner(unsigned int seed) : randomizer(seed) {}
+
+    // Call once at the start of every physics step
+    template <typename T>
+    void update(ParticleStore<T>& balls, uint64_t step, float simulated_time)
+    {
+        if (lifetime > 0) {
+            if (spawned.size() != max_balls) {
+                spawned.assign(max_balls, {});
+                oldest = spawned_count = 0;
+            }
+            while (spawned_count > 0 && step - spawned[oldest].step >= lifetime) despawnOldest(balls);
+        }
+        if (step % interval != 0) return;
+
+        for (uint32_t k{0}; k < burst && balls.size() < max_balls; ++k) {
+            const Scalar radius = randomScalar(randomizer, min_radius, max_radius);
+            const sf::Vector2f offset{0.f, 2.f * max_radius * k};
+            const ParticleHandle handle = balls.emplace_back(radius, Vec2(position + offset), speed, angle);
+            balls.setColor(balls.size() - 1, getRainbow(simulated_time));
+
+            if (lifetime == 0) continue;
+            if (spawned_count == spawned.size()) despawnOldest(balls);
+            spawned[(oldest + spawned_count) % spawned.size()] = {handle, step};
+            ++spawned_count;
+        }
+    }
+
+    // Balls erased at the end of their lifetime so far
+    [[nodiscard]] uint64_t getDespawnCount() const { return despawned;}
+
+    // RNG and lifetime ring as text, for snapshots. The ring names its balls by index in balls,
+    // handles do not survive a snapshot load.
+    template <typename T>
+    [[nodiscard]] std::string getState(const ParticleStore<T>& balls) const
+    {
+        std::ostringstream out;
+        out << randomizer.getState() << '\n' << despawned << ' ' << spawned_count;
+        for (size_t k{0}; k < spawned_count; ++k) {
+            const Spawned& entry = spawned[(oldest + k) % spawned.size()];
+            const int64_t index = balls.isAlive(entry.handle) ? static_cast<int64_t>(balls.indexOf(entry.handle)) : -1;
+            out << ' ' << index << ' ' << entry.step;
+        }
+        return out.str();
+    }
+
+    // Restore getState, balls holding what was saved along with it (Snapshot::load)
+    template <typename T>
+    void setState(const std::string& state, const ParticleStore<T>& balls)
+    {
+        const size_t end = state.find('\n');
+        randomizer.setState(state.substr(0, end));
+        oldest = spawned_count = 0;
+        despawned = 0;
+        if (end == std::string::npos) return;
+
+        std::istringstream in(state.substr(end + 1));
+        size_t count = 0;
+        in >> despawned >> count;
+        if (count > 0) spawned.assign(max_balls, {});
+        for (size_t k{0}; k < count && spawned_count < spawned.size(); ++k) {
+            int64_t index = -1;
+            uint64_t step = 0;
+            if (!(in >> index >> step)) break;
+            const bool alive = index >= 0 && static_cast<size_t>(index) < balls.size();
+            spawned[spawned_count++] = {alive ? balls.handleOf(static_cast<size_t>(index)) : ParticleHandle{}, step};
+        }
+    }
+};
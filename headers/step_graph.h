@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "job_system.h"
+#include "forces.h"
+#include "particles.h"
+#include "render_frame.h"
+#include "solver.h"
+
+// One substep of a ParticleStore as a TaskGraph, for a JobSystem to run:
+//
+//   forces -> integrate -> sweep -> borders -> broadphase -> contacts (even strips)
+//          -> contacts (odd strips) -> walls -> finish -> pack
+//
+// integrate, borders, walls and pack are split into chunks of balls, the contacts into strips of
+// grid columns with a free strip between any two that run together (as BroadPhase::ParallelGrid),
+// the rest are single tasks: forces (Forces::accumulate), sweep (reordering and continuous
+// collisions), broadphase (the grid) and finish (sleep, resizing the frame to pack into).
+// Strips do not depend on the thread count, so neither do the results.
+// Grid and ParallelGrid with Gauss-Seidel contacts are swept in strips, any other setting of the
+// Solver resolves every pair in the broadphase task, through Solver::resolvePairs.
+template <typename T, typename Walls>
+class StepGraph {
+private:
+    ParticleStore<T>& balls;
+    const Walls& walls;
+    TaskGraph graph;
+
+    size_t balls_per_task = 1024;
+    int columns_per_strip = 4;
+
+    // State of the substep running
+    RenderFrame* frame = nullptr;
+    bool resolving     = false;     // some ball is awake, Solver::beginCollisions
+    bool strips        = false;     // contacts are swept in strips
+    int columns        = 0;
+    std::atomic<uint64_t> tested{0}, colliding{0};
+
+    [[nodiscard]] size_t ballChunks() const { return (balls.size() + balls_per_task - 1) / balls_per_task;}
+    [[nodiscard]] size_t chunkBegin(size_t chunk) const { return chunk * balls_per_task;}
+    [[nodiscard]] size_t chunkEnd(size_t chunk) const { return std::min(balls.size(), (chunk + 1) * balls_per_task);}
+
+    [[nodiscard]] size_t stripCount() const { return static_cast<size_t>((columns + columns_per_strip - 1) / columns_per_strip);}
+
+    // Strip 2k + parity
+    void resolveStrip(size_t k, int parity)
+    {
+        const int first = (2 * static_cast<int>(k) + parity) * columns_per_strip;
+        const PairStats strip = Solver::resolveGridColumns(balls, first, std::min(columns, first + columns_per_strip));
+        tested.fetch_add(strip.tested, std::memory_order_relaxed);
+        colliding.fetch_add(strip.colliding, std::memory_order_relaxed);
+    }
+
+public:
+    StepGraph(ParticleStore<T>& store, const Walls& layout) : balls(store), walls(layout)
+    {
+        const auto one = [] { return size_t{1};};
+        const auto per_ball = [this] { return ballChunks();};
+        const auto per_ball_resolving = [this] { return resolving ? ballChunks() : size_t{0};};
+
+        const auto forces = graph.add("forces", one, [this](size_t) { Forces::accumulate(balls);});
+        const auto integrate = graph.add("integrate", per_ball, [this](size_t k) {
+            balls.updatePositions(chunkBegin(k), chunkEnd(k));
+        }, {forces});
+        const auto sweep = graph.add("sweep", one, [this](size_t) {
+            tested    = 0;
+            colliding = 0;
+            resolving = Solver::beginCollisions(balls, walls);
+            strips    = (Solver::getBroadPhase() == BroadPhase::Grid || Solver::getBroadPhase() == BroadPhase::ParallelGrid)
+                     && Solver::getContactSolver() == ContactSolver::GaussSeidel;
+        }, {integrate});
+        const auto borders = graph.add("borders", per_ball_resolving, [this](size_t k) {
+            Solver::resolveBorders(balls, chunkBegin(k), chunkEnd(k));
+        }, {sweep});
+        const auto broadphase = graph.add("broadphase", [this] { return resolving ? size_t{1} : size_t{0};}, [this](size_t) {
+            if (strips) columns = Solver::buildGrid(balls);
+            else Solver::resolvePairs(balls);
+        }, {borders});
+        const auto even = graph.add("contacts even", [this] { return resolving && strips ? (stripCount() + 1) / 2 : 0;},
+                                    [this](size_t k) { resolveStrip(k, 0);}, {broadphase});
+        const auto odd = graph.add("contacts odd", [this] { return resolving && strips ? stripCount() / 2 : 0;},
+                                   [this](size_t k) { resolveStrip(k, 1);}, {even});
+        const auto walls_phase = graph.add("walls", per_ball_resolving, [this](size_t k) {
+            Solver::resolveWalls(balls, walls, chunkBegin(k), chunkEnd(k));
+        }, {odd});
+        const auto finish = graph.add("finish", one, [this](size_t) {
+            if (resolving) Solver::endCollisions(balls, {tested.load(), colliding.load()});
+            if (frame) frame->resize(balls.size());
+        }, {walls_phase});
+        graph.add("pack", [this] { return frame ? ballChunks() : 0;}, [this](size_t k) {
+            frame->pack(balls, chunkBegin(k), chunkEnd(k));
+        }, {finish});
+    }
+
+    StepGraph(const StepGraph&) = delete;
+    StepGraph& operator=(const StepGraph&) = delete;
+
+    // Balls per chunk of integrate, borders, walls and pack, and grid columns per contact strip
+    // (at least 2). Smaller chunks balance better and cost more scheduling, see JobSystem::format.
+    void setBallsPerTask(size_t count) { balls_per_task = std::max<size_t>(count, 1);}
+    void setColumnsPerStrip(int count) { columns_per_strip = std::max(count, 2);}
+    [[nodiscard]] size_t getBallsPerTask() const { return balls_per_task;}
+    [[nodiscard]] int getColumnsPerStrip() const { return columns_per_strip;}
+
+    // Run one substep on jobs, then copy the balls into target (its step and stats are left to
+    // RenderFrame::stamp) unless it is null
+    void step(JobSystem& jobs, RenderFrame* target = nullptr)
+    {
+        frame = target;
+        jobs.run(graph);
+        frame = nullptr;
+    }
+
+    [[nodiscard]] const TaskGraph& getGraph() const { return graph;}
+};
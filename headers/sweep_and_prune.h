@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <numeric>
+
+// Sort-and-sweep broadphase along x
+// Balls are kept sorted by the left edge of their bounding box from one step to the next.
+// They barely move in a step, so the insertion sort that restores the order is close to linear,
+// and unlike a grid the cost does not depend on the spread of radii.
+class SweepAndPrune {
+private:
+    std::vector<uint32_t> order;        // ball indices sorted by min_x, kept between steps
+    std::vector<Scalar> min_x, max_x;    // bounds of the ball in each sorted slot
+    std::vector<Scalar> min_y, max_y;
+    std::vector<uint32_t> scratch;
+    std::vector<Scalar> bound_scratch;   // swapped with each bounds array in turn by sortFromScratch
+    uint64_t swaps = 0;
+
+    // Full sort when the previous order is of little use (first step, many new balls)
+    void sortFromScratch(size_t count)
+    {
+        scratch.resize(count);
+        std::iota(scratch.begin(), scratch.end(), 0u);
+        std::sort(scratch.begin(), scratch.end(), [this](uint32_t a, uint32_t b) { return min_x[a] < min_x[b];});
+        for (auto* bounds : {&min_x, &max_x, &min_y, &max_y}) {
+            bound_scratch.resize(count);
+            for (size_t k{0}; k < count; ++k) bound_scratch[k] = (*bounds)[scratch[k]];
+            bounds->swap(bound_scratch);
+        }
+        for (size_t k{0}; k < count; ++k) scratch[k] = order[scratch[k]];
+        order.swap(scratch);
+    }
+
+    void insertionSort()
+    {
+        for (size_t k{1}; k < order.size(); ++k) {
+            const Scalar key = min_x[k];
+            if (min_x[k - 1] <= key) continue;
+
+            const uint32_t ball = order[k];
+            const Scalar right = max_x[k], top = min_y[k], bottom = max_y[k];
+            size_t m = k;
+            for (; m > 0 && min_x[m - 1] > key; --m) {
+                order[m] = order[m - 1];
+                min_x[m] = min_x[m - 1];    max_x[m] = max_x[m - 1];
+                min_y[m] = min_y[m - 1];    max_y[m] = max_y[m - 1];
+            }
+            swaps += k - m;
+            order[m] = ball;
+            min_x[m] = key;     max_x[m] = right;
+            min_y[m] = top;     max_y[m] = bottom;
+        }
+    }
+
+public:
+    // Refresh the bounds and restore the order, position(i) and radius(i) describe ball i.
+    // New balls are expected at the end (indices count - k .. count - 1). Removed balls are
+    // expected to have been replaced by the last ones (ParticleStore::erase), so dropping the
+    // indices past the end leaves every ball in the order exactly once.
+    template <typename PositionFn, typename RadiusFn>
+    void update(size_t count, PositionFn position, RadiusFn radius)
+    {
+        if (order.size() > count) {
+            order.erase(std::remove_if(order.begin(), order.end(), [count](uint32_t i) { return i >= count;}), order.end());
+        }
+        const size_t kept = order.size();
+        for (size_t i{kept}; i < count; ++i) order.push_back(static_cast<uint32_t>(i));
+
+        min_x.resize(count);    max_x.resize(count);
+        min_y.resize(count);    max_y.resize(count);
+        for (size_t k{0}; k < count; ++k) {
+            const uint32_t i = order[k];
+            const auto p = position(i);
+            const Scalar r = radius(i);
+            min_x[k] = p.x - r;     max_x[k] = p.x + r;
+            min_y[k] = p.y - r;     max_y[k] = p.y + r;
+        }
+
+        swaps = 0;
+        if (2 * kept < count) sortFromScratch(count);
+        else insertionSort();
+    }
+
+    // The balls were permuted in storage, ball i now has index new_index[i]. The sorted order
+    // only names them differently, so it carries over to the next update. Balls added since the
+    // last update would no longer be the last indices and join the order here instead.
+    void renumber(const std::vector<uint32_t>& new_index)
+    {
+        const size_t count = new_index.size();
+        order.erase(std::remove_if(order.begin(), order.end(), [count](uint32_t i) { return i >= count;}), order.end());
+        const size_t kept = order.size();
+        for (auto& i : order) i = new_index[i];
+        for (size_t i{kept}; i < count; ++i) order.push_back(new_index[i]);
+    }
+
+    // Visit every pair whose bounding boxes overlap, once
+    template <typename PairFn>
+    void forEachPair(PairFn&& pair) const
+    {
+        const size_t count = order.size();
+        for (size_t a{0}; a < count; ++a) {
+            for (size_t b{a + 1}; b < count && min_x[b] <= max_x[a]; ++b) {
+                if (min_y[b] <= max_y[a] && min_y[a] <= max_y[b]) pair(order[a], order[b]);
+            }
+        }
+    }
+
+    // Slots moved by the last insertion sort, a measure of how coherent the step was
+    [[nodiscard]] uint64_t getSwapCount() const { return swaps;}
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using ParallelInvoke = void (*)(const void* task, size_t i);
+
+// Scheduler that takes over ThreadPool::parallelFor on the threads it runs on (JobSystem while it
+// runs a graph), so a pool called from one of its tasks shares out to the threads already busy
+// with the graph instead of starting a second set that competes with them for the cores
+struct ParallelForDelegate {
+    void* context = nullptr;
+    void (*parallel_for)(void* context, size_t count, const void* task, ParallelInvoke invoke) = nullptr;
+};
+inline thread_local ParallelForDelegate parallel_for_delegate;
+
+// Fixed set of worker threads that split index ranges between them.
+// The calling thread works too, so a pool of size n runs n - 1 extra threads.
+// The task is only referenced while parallelFor runs, never copied, so a call does not allocate.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake_workers;
+    std::condition_variable job_finished;
+
+    const void* job = nullptr;
+    ParallelInvoke invoke = nullptr;
+    std::atomic<size_t> next_index{0};
+    size_t job_size     = 0;
+    size_t busy_workers = 0;
+    uint64_t generation = 0;
+    bool stopping       = false;
+
+    void runJob()
+    {
+        for (size_t i = next_index.fetch_add(1); i < job_size; i = next_index.fetch_add(1)) {
+            invoke(job, i);
+        }
+    }
+
+    void workerLoop()
+    {
+        uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake_workers.wait(lock, [&] { return stopping || generation != seen_generation; });
+                if (stopping) return;
+                seen_generation = generation;
+            }
+
+            runJob();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy_workers == 0) job_finished.notify_one();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency())
+    {
+        thread_count = std::max<size_t>(thread_count, 1);
+        for (size_t i{1}; i < thread_count; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake_workers.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    [[nodiscard]] size_t size() const { return workers.size() + 1;}
+
+    // Call task(i) for every i in [0, count) and wait until all of them returned
+    template <typename Task>
+    void parallelFor(size_t count, const Task& task)
+    {
+        if (count == 0) return;
+        const ParallelInvoke call = [](const void* context, size_t i) { (*static_cast<const Task*>(context))(i); };
+        if (parallel_for_delegate.parallel_for && count > 1) {
+            parallel_for_delegate.parallel_for(parallel_for_delegate.context, count, &task, call);
+            return;
+        }
+        if (workers.empty() || count == 1) {
+            for (size_t i{0}; i < count; ++i) task(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job          = &task;
+            invoke       = call;
+            job_size     = count;
+            next_index   = 0;
+            busy_workers = workers.size();
+            ++generation;
+        }
+        wake_workers.notify_all();
+
+        runJob();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        job_finished.wait(lock, [&] { return busy_workers == 0; });
+    }
+};
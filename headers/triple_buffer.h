@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer triple buffer
+// The producer fills its back slot and publishes it, the consumer switches to the newest published
+// slot when it wants. Neither side ever waits for the other: the producer always owns a slot to fill
+// and the consumer keeps reading its own until it asks for a newer one. Frames published faster than
+// the consumer looks are overwritten. The three slots change hands through one atomic index.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;     // the middle slot holds a frame the consumer has not taken
+
+    T slots[3];
+    uint8_t back  = 0;                      // producer only
+    uint8_t front = 1;                      // consumer only
+    std::atomic<uint8_t> middle{2};
+
+public:
+    // Slot the producer fills, it still holds what was written there three publishes ago
+    [[nodiscard]] T& write() { return slots[back];}
+
+    // Hand the filled slot over and take back the middle one, read or not
+    void publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;}
+
+    // Switch to the newest published slot, false if nothing was published since the last switch
+    bool update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // Slot the consumer reads, unchanged until its next update
+    [[nodiscard]] const T& read() const { return slots[front];}
+};
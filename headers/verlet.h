@@ -1,14 +1,17 @@
 #pragma once
 #include "ball.h"
 #include "wall.h"
+#include "particles.h"
+#include "forces.h"
+#include "verlet_simd.h"
 
 class VerletBall : public Ball {
 private:
-    sf::Vector2f previous_position;
+    Vec2 previous_position;
 public:
     // Constructor delegation
-    VerletBall(float radius, sf::Vector2f init_position, float init_speed, float angle)
-        : Ball(radius, init_position, init_speed, angle) 
+    VerletBall(Scalar radius, Vec2 init_position, Scalar init_speed, Scalar angle)
+        : Ball(radius, init_position, init_speed, angle)
     {
         previous_position = position - velocity * deltaTime;
     }
@@ -16,25 +19,25 @@ public:
     void updatePosition() {
         // Verlet Integration: derived from the second derivative
         // x(n+1) = 2 * x(n) - x(n-1) + a * dt^2
-        sf::Vector2f temp_position = position;
-        position = 2.f * position - previous_position + acceleration * (deltaTime * deltaTime);
+        Vec2 temp_position = position;
+        position = Scalar(2) * position - previous_position + acceleration * (deltaTime * deltaTime);
         previous_position = temp_position;
-        circleObject.setPosition(position);
+        setShapePosition(position);
     }
 
-    [[nodiscard]] sf::Vector2f getPosition() const
+    [[nodiscard]] Vec2 getPosition() const
     {
         return position;
     }
 
-    [[nodiscard]] sf::Vector2f getVelocity() const 
+    [[nodiscard]] Vec2 getVelocity() const
     {
         return (position - previous_position) / deltaTime;
     }
 
-    [[nodiscard]] float getSpeed() const noexcept
+    [[nodiscard]] Scalar getSpeed() const noexcept
     {
-        sf::Vector2f v = getVelocity();
+        Vec2 v = getVelocity();
         return utils::norm2f(v);
     }
 
@@ -42,16 +45,56 @@ public:
 };
 
 
+template<>
+inline void ParticleStore<VerletBall>::updatePositions(size_t first, size_t last)
+{
+    // Fields that vary between balls need each ball's own acceleration
+    if (!Forces::isUniform() || hasInteractions()) {
+        const bool interacting = hasInteractions();
+        const Scalar dt2 = deltaTime * deltaTime;
+        for (size_t i{first}; i < last; ++i) {
+            if (asleep[i]) continue;
+            Vec2 acceleration = Forces::at({x[i], y[i]}, getVelocity(i));
+            if (interacting) acceleration += Vec2{ax[i], ay[i]};
+            const Scalar next_x = 2.f * x[i] - prev_x[i] + acceleration.x * dt2;
+            const Scalar next_y = 2.f * y[i] - prev_y[i] + acceleration.y * dt2;
+            prev_x[i] = x[i];   x[i] = next_x;
+            prev_y[i] = y[i];   y[i] = next_y;
+        }
+        return;
+    }
+
+    // x(n+1) = 2 * x(n) - x(n-1) + a * dt^2, vectorized over each coordinate array
+    const Scalar step_x = Forces::getUniform().x * (deltaTime * deltaTime);
+    const Scalar step_y = Forces::getUniform().y * (deltaTime * deltaTime);
+    if (getSleepingCount() == 0) {
+        simd::verlet(x.data() + first, prev_x.data() + first, last - first, step_x);
+        simd::verlet(y.data() + first, prev_y.data() + first, last - first, step_y);
+        return;
+    }
+
+    // Integrate each run of awake balls, sleeping balls stay where they are
+    for (size_t begin{first}; begin < last;) {
+        if (asleep[begin]) {
+            ++begin;
+            continue;
+        }
+        size_t end = begin + 1;
+        while (end < last && !asleep[end]) ++end;
+        simd::verlet(x.data() + begin, prev_x.data() + begin, end - begin, step_x);
+        simd::verlet(y.data() + begin, prev_y.data() + begin, end - begin, step_y);
+        begin = end;
+    }
+}
+
 
 template<>
 class CollisionSolver<VerletBall> {
     CollisionSolver() = default;
-public:
-    static void handleBorderCollision(VerletBall& ball, const int& windowWidth, const int& windowHeight) {
-        sf::Vector2f& position          = ball.position;
-        sf::Vector2f& previous_position = ball.previous_position;
-        sf::Vector2f  current_velocity  = position - previous_position;
-        auto& radius = ball.radius;
+
+    static void bounceOffBorder(Vec2& position, Vec2& previous_position, const Scalar radius,
+                                const int windowWidth, const int windowHeight) {
+        Vec2 current_velocity = position - previous_position;
 
         // Handle wall collisions
         if (position.x + radius > windowWidth) {
@@ -74,60 +117,105 @@ public:
             position.y = radius;
             previous_position.y = position.y + RESTITUTION * current_velocity.y;
         }
-
-        ball.circleObject.setPosition(position);
     }
 
-    // Position-based collision
-    static void resolvePairCollision(VerletBall& ballA, VerletBall& ballB) {
-        sf::Vector2f& posA = ballA.position;
-        sf::Vector2f& posB = ballB.position;
-
-        sf::Vector2f delta = posB - posA;
-        float dist2        = delta.x * delta.x + delta.y * delta.y;
-        float min_dist     = ballA.radius + ballB.radius;
+    // Push two overlapping balls apart, returns false if they do not touch
+    static bool separate(Vec2& posA, Vec2& posB, const Scalar radiusA, const Scalar radiusB) {
+        Vec2 delta = posB - posA;
+        Scalar dist2        = delta.x * delta.x + delta.y * delta.y;
+        Scalar min_dist     = radiusA + radiusB;
 
         // Check if there is overlap
         if (dist2 < min_dist * min_dist) {
-            float dist          = std::sqrt(dist2);
-            float overlap       = min_dist - dist;
-            sf::Vector2f normal = delta / dist;
+            Scalar dist          = utils::sqrt(dist2);
+            Scalar overlap       = min_dist - dist;
+            // Coincident centres (both clamped into the same corner) part along x
+            Vec2 normal = dist > Scalar(0) ? delta / dist : Vec2{1.f, 0.f};
 
-            const float mass_ratioA = ballA.radius / min_dist;
-            const float mass_ratioB = ballB.radius / min_dist;
+            const Scalar mass_ratioA = radiusA / min_dist;
+            const Scalar mass_ratioB = radiusB / min_dist;
 
-            sf::Vector2f correction = normal * RESTITUTION * overlap;
+            Vec2 correction = normal * RESTITUTION * overlap;
             posA -= correction * mass_ratioB;
             posB += correction * mass_ratioA;
-            
-            ballA.circleObject.setPosition(posA);
-            ballB.circleObject.setPosition(posB);
+            return true;
         }
+        return false;
     }
 
-    static void resolveWallCollision(VerletBall& ball, Wall& wall) {
-        sf::Vector2f closest_point   = closestPointToWall(ball, wall);
-        sf::Vector2f ball_to_closest = closest_point - ball.position;
-        float dist    = utils::norm2f(ball_to_closest);
-        float overlap = ball.radius - dist;
+    static bool bounceOffWall(Vec2& position, Vec2& previous_position, const Scalar radius, const Wall& wall) {
+        Vec2 closest_point   = closestPointToWall(position, wall);
+        Vec2 ball_to_closest = closest_point - position;
+        Scalar dist    = utils::norm2f(ball_to_closest);
+        Scalar overlap = radius - dist;
 
-        if (dist < ball.radius) {
+        if (dist < radius) {
             // Calculate the normal vector from the ball to the closest point on the wall
-            sf::Vector2f normal = utils::normalize(ball_to_closest);
+            Vec2 normal = utils::normalize(ball_to_closest);
 
             // Calculate the correction vector based on the overlap
-            sf::Vector2f correction = normal * overlap;
+            Vec2 correction = normal * overlap;
 
             // Adjust the ball's position to resolve the collision
-            ball.position -= correction;
-            ball.circleObject.setPosition(ball.position);
+            position -= correction;
 
             // Adjust the ball's velocity to reflect the bounce off the wall
-            sf::Vector2f current_position = ball.position;
-            sf::Vector2f current_velocity = current_position - ball.previous_position;
-            sf::Vector2f reflected_velocity = current_velocity - 2.f * utils::dot(current_velocity, normal) * normal;
-            ball.previous_position = ball.position - reflected_velocity;
+            Vec2 current_velocity = position - previous_position;
+            Vec2 reflected_velocity = current_velocity - Scalar(2) * utils::dot(current_velocity, normal) * normal;
+            previous_position = position - reflected_velocity;
+            return true;
+        }
+        return false;
+    }
 
+public:
+    static void handleBorderCollision(VerletBall& ball, const int& windowWidth, const int& windowHeight) {
+        bounceOffBorder(ball.position, ball.previous_position, ball.radius, windowWidth, windowHeight);
+        ball.setShapePosition(ball.position);
+    }
+
+    // Position-based collision
+    static bool resolvePairCollision(VerletBall& ballA, VerletBall& ballB) {
+        if (separate(ballA.position, ballB.position, ballA.radius, ballB.radius)) {
+            ballA.setShapePosition(ballA.position);
+            ballB.setShapePosition(ballB.position);
+            return true;
         }
+        return false;
     }
-};
\ No newline at end of file
+
+    static void resolveWallCollision(VerletBall& ball, const Wall& wall) {
+        if (bounceOffWall(ball.position, ball.previous_position, ball.radius, wall)) {
+            ball.setShapePosition(ball.position);
+        }
+    }
+
+    // Structure-of-arrays versions, i and j index into the store
+    static void handleBorderCollision(ParticleStore<VerletBall>& balls, size_t i, const int& windowWidth, const int& windowHeight) {
+        Vec2 position{balls.x[i], balls.y[i]};
+        Vec2 previous_position{balls.prev_x[i], balls.prev_y[i]};
+        bounceOffBorder(position, previous_position, balls.radius[i], windowWidth, windowHeight);
+        balls.x[i] = position.x;                   balls.y[i] = position.y;
+        balls.prev_x[i] = previous_position.x;     balls.prev_y[i] = previous_position.y;
+    }
+
+    static bool resolvePairCollision(ParticleStore<VerletBall>& balls, size_t i, size_t j) {
+        Vec2 posA{balls.x[i], balls.y[i]};
+        Vec2 posB{balls.x[j], balls.y[j]};
+        if (separate(posA, posB, balls.radius[i], balls.radius[j])) {
+            balls.x[i] = posA.x;    balls.y[i] = posA.y;
+            balls.x[j] = posB.x;    balls.y[j] = posB.y;
+            return true;
+        }
+        return false;
+    }
+
+    static void resolveWallCollision(ParticleStore<VerletBall>& balls, size_t i, const Wall& wall) {
+        Vec2 position{balls.x[i], balls.y[i]};
+        Vec2 previous_position{balls.prev_x[i], balls.prev_y[i]};
+        if (bounceOffWall(position, previous_position, balls.radius[i], wall)) {
+            balls.x[i] = position.x;                   balls.y[i] = position.y;
+            balls.prev_x[i] = previous_position.x;     balls.prev_y[i] = previous_position.y;
+        }
+    }
+};
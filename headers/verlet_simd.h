@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include "../utils/cpu.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define VERLET_SIMD_X86
+    #include <immintrin.h>
+#endif
+
+// Let GCC and Clang emit AVX2 for a single function without building everything with -mavx2
+#if defined(__GNUC__) || defined(__clang__)
+    #define VERLET_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define VERLET_TARGET(isa)
+#endif
+
+// Batched Verlet integration over one coordinate array:
+// position = 2 * position - previous + acceleration, previous = old position.
+// Every kernel does the same operations in the same order (no FMA), so they agree bit for bit.
+namespace simd {
+
+enum class Isa { Scalar, SSE2, AVX2 };
+
+template <typename T>
+inline void verletScalar(T* position, T* previous, size_t count, T acceleration) {
+    for (size_t i{0}; i < count; ++i) {
+        const T current = position[i];
+        position[i] = T(2) * current - previous[i] + acceleration;
+        previous[i] = current;
+    }
+}
+
+#ifdef VERLET_SIMD_X86
+VERLET_TARGET("sse2")
+inline void verletSSE2(float* position, float* previous, size_t count, float acceleration) {
+    const __m128 two = _mm_set1_ps(2.f);
+    const __m128 acc = _mm_set1_ps(acceleration);
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        const __m128 current = _mm_loadu_ps(position + i);
+        const __m128 last    = _mm_loadu_ps(previous + i);
+        _mm_storeu_ps(position + i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(two, current), last), acc));
+        _mm_storeu_ps(previous + i, current);
+    }
+    verletScalar(position + i, previous + i, count - i, acceleration);
+}
+
+VERLET_TARGET("avx2")
+inline void verletAVX2(float* position, float* previous, size_t count, float acceleration) {
+    const __m256 two = _mm256_set1_ps(2.f);
+    const __m256 acc = _mm256_set1_ps(acceleration);
+    size_t i{0};
+    for (; i + 8 <= count; i += 8) {
+        const __m256 current = _mm256_loadu_ps(position + i);
+        const __m256 last    = _mm256_loadu_ps(previous + i);
+        _mm256_storeu_ps(position + i, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(two, current), last), acc));
+        _mm256_storeu_ps(previous + i, current);
+    }
+    verletScalar(position + i, previous + i, count - i, acceleration);
+}
+#endif
+
+[[nodiscard]] inline bool isSupported(Isa isa) {
+#ifdef VERLET_SIMD_X86
+    switch (isa) {
+        case Isa::Scalar: return true;
+        case Isa::SSE2:   return utils::cpuFeatures().sse2;
+        case Isa::AVX2:   return utils::cpuFeatures().avx2;
+    }
+#endif
+    return isa == Isa::Scalar;
+}
+
+[[nodiscard]] inline Isa bestIsa() {
+    if (isSupported(Isa::AVX2)) return Isa::AVX2;
+    if (isSupported(Isa::SSE2)) return Isa::SSE2;
+    return Isa::Scalar;
+}
+
+inline Isa& activeIsa() {
+    static Isa isa = bestIsa();
+    return isa;
+}
+
+// Force a kernel, e.g. the scalar one for comparison. Returns false if the CPU lacks it.
+inline bool setIsa(Isa isa) {
+    if (!isSupported(isa)) return false;
+    activeIsa() = isa;
+    return true;
+}
+
+[[nodiscard]] inline Isa getIsa() { return activeIsa();}
+
+inline const char* toString(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::SSE2:   return "sse2";
+        case Isa::AVX2:   return "avx2";
+    }
+    return "";
+}
+
+inline void verlet(float* position, float* previous, size_t count, float acceleration) {
+#ifdef VERLET_SIMD_X86
+    switch (activeIsa()) {
+        case Isa::AVX2: verletAVX2(position, previous, count, acceleration); return;
+        case Isa::SSE2: verletSSE2(position, previous, count, acceleration); return;
+        case Isa::Scalar: break;
+    }
+#endif
+    verletScalar(position, previous, count, acceleration);
+}
+
+// double and fixed-point builds (Scalar) take the plain loop
+template <typename T>
+inline void verlet(T* position, T* previous, size_t count, T acceleration) {
+    verletScalar(position, previous, count, acceleration);
+}
+
+}
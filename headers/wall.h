@@ -1,5 +1,6 @@
 #pragma once
 #include "ball.h"
+#include "scalar.h"
 #define HAVE_SFML
 #include "../utils/math.h"
 #include "../utils/constants.h"
@@ -9,38 +10,46 @@ using namespace mathematical;
 class Wall {
 private:
     sf::RectangleShape rectangle;
-    sf::Vector2f starting_position;
-    sf::Vector2f unit_normal;
-    float angle; // incline in radians
-    float width;
-    float length;
+    Vec2 starting_position;
+    Vec2 ending_position;
+    Vec2 direction;     // unit vector from start to end
+    Vec2 unit_normal;
+    Scalar angle; // incline in radians
+    Scalar angle_degrees;
+    Scalar width;
+    Scalar length;
 public:
-    Wall(sf::Vector2f starting_position, float length, float width, float angle_degrees)
+    Wall(Vec2 starting_position, Scalar length, Scalar width, Scalar angle_degrees)
         : starting_position(starting_position),
-        length(length),
+        angle(angle_degrees * Scalar(PI_f) / Scalar(180)), // Convert once here to radians
+        angle_degrees(angle_degrees),
         width(width),
-        angle(angle_degrees * PI_f / 180.f) // Convert once here to radians
+        length(length)
     {
-        unit_normal = sf::Vector2f(std::cos(angle + PI_f / 2), std::sin(angle + PI_f / 2));
-        rectangle.setSize(sf::Vector2f(length, width));
-        rectangle.setPosition(starting_position);
-        rectangle.setRotation(angle_degrees);
+        ending_position = starting_position + length * Vec2(utils::cos(angle), utils::sin(angle));
+        direction   = utils::normalize(ending_position - starting_position);
+        unit_normal = Vec2(utils::cos(angle + Scalar(PI_f) / Scalar(2)), utils::sin(angle + Scalar(PI_f) / Scalar(2)));
+        rectangle.setSize(sf::Vector2f(static_cast<float>(length), static_cast<float>(width)));
+        rectangle.setPosition(sf::Vector2f(starting_position));
+        rectangle.setRotation(static_cast<float>(angle_degrees));
         setColor();
 
     }
 
-    const float WALL_FRICTION = 0.98f;
+    const Scalar WALL_FRICTION = 0.98f;
 
     void setColor(sf::Color color = sf::Color::White) {
         rectangle.setFillColor(color);
     }
 
-    [[nodiscard]] sf::Vector2f getUnitNormal() { return unit_normal;}
-    [[nodiscard]] sf::Vector2f getStartingPoint(){ return starting_position;}
-    [[nodiscard]] sf::Vector2f getEndingPoint(){ return starting_position + length * sf::Vector2f(std::cos(angle), std::sin(angle));}
-    [[nodiscard]] float getIncline()   const { return angle;}
-    [[nodiscard]] float getLength() const { return length;}
-    [[nodiscard]] float getWidth() const { return width;}
+    [[nodiscard]] Vec2 getUnitNormal() const { return unit_normal;}
+    [[nodiscard]] Vec2 getStartingPoint() const { return starting_position;}
+    [[nodiscard]] Vec2 getEndingPoint() const { return ending_position;}
+    [[nodiscard]] Vec2 getDirection() const { return direction;}
+    [[nodiscard]] Scalar getIncline()   const { return angle;}
+    [[nodiscard]] Scalar getInclineDegrees() const { return angle_degrees;}
+    [[nodiscard]] Scalar getLength() const { return length;}
+    [[nodiscard]] Scalar getWidth() const { return width;}
 
     void draw(sf::RenderWindow& window) const 
     {
@@ -48,20 +57,24 @@ public:
     }
 };
 
-template<typename T>
-sf::Vector2f closestPointToWall(T& ball, Wall& wall){
-    sf::Vector2f BallToWallStart = wall.getStartingPoint() - ball.getPosition();
-    sf::Vector2f WallUnitVec = utils::normalize(wall.getEndingPoint() - wall.getStartingPoint());
+inline Vec2 closestPointToWall(Vec2 position, const Wall& wall){
+    Vec2 BallToWallStart = wall.getStartingPoint() - position;
+    Vec2 WallUnitVec = wall.getDirection();
     if(utils::dot(WallUnitVec, BallToWallStart) > 0){
         return wall.getStartingPoint();
     }
 
-    sf::Vector2f WallEndToBall = ball.getPosition() - wall.getEndingPoint();
+    Vec2 WallEndToBall = position - wall.getEndingPoint();
     if(utils::dot(WallUnitVec, WallEndToBall) > 0){
         return wall.getEndingPoint();
     }
 
-    float closest_dist = utils::dot(WallUnitVec, BallToWallStart);
-    sf::Vector2f ClosestVec = WallUnitVec * closest_dist;
+    Scalar closest_dist = utils::dot(WallUnitVec, BallToWallStart);
+    Vec2 ClosestVec = WallUnitVec * closest_dist;
     return (wall.getStartingPoint() - ClosestVec);
+}
+
+template<typename T>
+Vec2 closestPointToWall(T& ball, const Wall& wall){
+    return closestPointToWall(ball.getPosition(), wall);
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "wall.h"
+
+// Immutable bounding-box tree over static walls
+// Built once from the level layout, then every ball only visits the walls whose box
+// overlaps its own, so wall collisions cost O(log walls) per ball instead of O(walls).
+class WallTree {
+private:
+    struct Bounds {
+        Vec2 min, max;
+
+        void grow(const Bounds& other) {
+            min = {std::min(min.x, other.min.x), std::min(min.y, other.min.y)};
+            max = {std::max(max.x, other.max.x), std::max(max.y, other.max.y)};
+        }
+
+        [[nodiscard]] bool overlaps(const Bounds& other) const {
+            return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+        }
+    };
+
+    // Leaves own items[first, first + count), inner nodes have count 0,
+    // their left child right after them and their right child at index right
+    struct Node {
+        Bounds bounds;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint32_t right = 0;
+    };
+
+    static constexpr uint32_t LEAF_SIZE = 4;
+    static constexpr size_t MAX_DEPTH   = 64;
+
+    std::vector<Wall> walls;
+    std::vector<Bounds> wall_bounds;
+    std::vector<uint32_t> items;        // wall indices, grouped by leaf
+    std::vector<Node> nodes;
+
+    static Bounds boundsOf(const Wall& wall) {
+        const Vec2 a = wall.getStartingPoint(), b = wall.getEndingPoint();
+        return {{std::min(a.x, b.x), std::min(a.y, b.y)}, {std::max(a.x, b.x), std::max(a.y, b.y)}};
+    }
+
+    // Median split along the longest side of the node, returns the node index
+    uint32_t build(uint32_t first, uint32_t last, size_t depth) {
+        const uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        Bounds bounds = wall_bounds[items[first]];
+        for (uint32_t k{first + 1}; k < last; ++k) bounds.grow(wall_bounds[items[k]]);
+        nodes[index].bounds = bounds;
+
+        if (last - first <= LEAF_SIZE || depth + 1 >= MAX_DEPTH) {
+            nodes[index].first = first;
+            nodes[index].count = last - first;
+            return index;
+        }
+
+        const bool along_x = bounds.max.x - bounds.min.x >= bounds.max.y - bounds.min.y;
+        auto centre = [&](uint32_t wall) {
+            const Bounds& b = wall_bounds[wall];
+            return along_x ? b.min.x + b.max.x : b.min.y + b.max.y;
+        };
+        const uint32_t middle = first + (last - first) / 2;
+        std::nth_element(items.begin() + first, items.begin() + middle, items.begin() + last,
+                         [&](uint32_t a, uint32_t b) { return centre(a) < centre(b);});
+
+        build(first, middle, depth + 1);
+        const uint32_t right = build(middle, last, depth + 1);
+        nodes[index].right = right;
+        return index;
+    }
+
+public:
+    WallTree() = default;
+
+    explicit WallTree(std::vector<Wall> layout) : walls(std::move(layout)) {
+        if (walls.empty()) return;
+
+        wall_bounds.reserve(walls.size());
+        items.reserve(walls.size());
+        for (size_t i{0}; i < walls.size(); ++i) {
+            wall_bounds.push_back(boundsOf(walls[i]));
+            items.push_back(static_cast<uint32_t>(i));
+        }
+        nodes.reserve(2 * walls.size() / LEAF_SIZE + 1);
+        build(0, static_cast<uint32_t>(walls.size()), 0);
+    }
+
+    // Call fn(wall) for every wall whose bounding box overlaps the circle's
+    template <typename WallFn>
+    void query(Vec2 centre, Scalar radius, WallFn&& fn) const {
+        if (nodes.empty()) return;
+
+        const Bounds ball{{centre.x - radius, centre.y - radius}, {centre.x + radius, centre.y + radius}};
+        uint32_t stack[MAX_DEPTH + 1];
+        size_t top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const uint32_t index = stack[--top];
+            const Node& node = nodes[index];
+            if (!node.bounds.overlaps(ball)) continue;
+
+            if (node.count > 0) {
+                for (uint32_t k{node.first}; k < node.first + node.count; ++k) {
+                    if (wall_bounds[items[k]].overlaps(ball)) fn(walls[items[k]]);
+                }
+                continue;
+            }
+            stack[top++] = node.right;
+            stack[top++] = index + 1;
+        }
+    }
+
+    [[nodiscard]] const std::vector<Wall>& getWalls() const { return walls;}
+    [[nodiscard]] size_t size() const { return walls.size();}
+    [[nodiscard]] bool empty() const { return walls.empty();}
+    [[nodiscard]] size_t getNodeCount() const { return nodes.size();}
+};
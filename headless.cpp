@@ -0,0 +1,466 @@
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#define HAVE_SFML
+#include "utils/random.h"
+#include "headers/solver.h"
+#include "headers/step_graph.h"
+#include "headers/spawner.h"
+#include "headers/snapshot.h"
+#include "headers/replay.h"
+#include "utils/profiler.h"
+
+// Headless runner: steps the simulation for a fixed number of steps without opening a window,
+// on simulated time only, and reports throughput.
+//
+//   headless --balls 20000 --integrator verlet --broadphase grid --steps 2000 --seed 42
+
+struct Scenario {
+    std::string integrator = "verlet";      // verlet, euler, implicit, rk4 or rk45
+    float tolerance        = 0.01f;         // rk45 local error per step, in pixels
+    BroadPhase broad_phase = BroadPhase::Grid;
+    size_t threads         = 0;             // 0 = one per core
+    size_t jobs            = 0;             // threads of the step graph, 0 runs the phases in line
+    size_t chunk           = 1024;          // balls per task of the step graph
+    int strip              = 4;             // grid columns per contact strip of the step graph
+    uint32_t balls         = 1200;
+    uint32_t steps         = 1000;
+    uint32_t substeps      = 1;
+    float physics_rate     = 120.f;
+    float spawn_delay      = 0.025f;        // simulated seconds between spawns, 0 places every ball up front
+    uint32_t burst         = 1;             // balls per spawn
+    float lifetime         = 0.f;           // simulated seconds a spawned ball lives, 0 = forever
+    float min_radius       = 2.f;
+    float max_radius       = 25.f;
+    uint32_t boulders      = 0;             // extra balls of boulder_radius placed up front
+    float boulder_radius   = 100.f;
+    unsigned int seed      = 42;
+    bool walls             = false;
+    uint32_t wall_segments = 0;             // extra random short walls, to stress the wall tree
+    bool profile           = false;         // print the average time of every phase
+    bool sleep             = false;         // let resting balls fall asleep
+    bool ccd               = false;         // sweep fast balls against walls, borders and balls
+    uint32_t reorder       = 0;             // sort the balls along a Z curve every N substeps, 0 = never
+    ContactSolver contact_solver = ContactSolver::GaussSeidel;
+    float relaxation       = 1.f;           // Jacobi over-relaxation, 1 averages the corrections
+    float drag             = 0.f;           // velocity damping in 1/s
+    float nbody            = 0.f;           // gravitational constant of mutual gravity, 0 = uniform gravity
+    float theta            = 0.5f;          // Barnes–Hut opening angle
+    std::vector<Attractor> attractors;
+    std::string trace;                      // Chrome trace-event JSON output, empty for none
+    std::string load;                       // snapshot to start from
+    std::string save;                       // snapshot written after the last step
+    std::string replay;                     // user shots recorded by the windowed demo
+    bool seed_given        = false;         // set on the command line, a replay must agree with them
+    bool substeps_given    = false;
+    bool rate_given        = false;
+};
+
+static void printUsage()
+{
+    std::printf(
+        "usage: headless [options]\n"
+        "  --integrator verlet|euler|implicit|rk4|rk45  ball type (default verlet)\n"
+        "  --tolerance PX                  rk45 local error allowed per step (default 0.01)\n"
+        "  --broadphase brute|grid|parallel|sap|hgrid\n"
+        "  --contacts gauss|colored|jacobi  contact solving of the grid broadphases (default gauss)\n"
+        "  --relaxation W                  over-relaxation of --contacts jacobi (default 1, the average)\n"
+        "  --threads N                     threads for the parallel broadphase, contacts and --nbody (default: cores)\n"
+        "  --jobs N                        run each substep as a task graph on N work-stealing threads\n"
+        "  --chunk N                       balls per task of --jobs (default 1024)\n"
+        "  --strip N                       grid columns per contact strip of --jobs (default 4)\n"
+        "  --balls N                       number of balls (default 1200)\n"
+        "  --steps N                       physics steps to run (default 1000)\n"
+        "  --substeps N                    substeps per step (default 1)\n"
+        "  --rate HZ                       physics steps per simulated second (default 120)\n"
+        "  --spawn-delay S                 simulated seconds between spawns, 0 = all at once (default 0.025)\n"
+        "  --burst N                       balls per spawn (default 1)\n"
+        "  --lifetime S                    erase spawned balls after S simulated seconds (default: never)\n"
+        "  --radius MIN MAX                radius range in pixels (default 2 25)\n"
+        "  --boulders N R                  add N balls of radius R at random places up front\n"
+        "  --seed N                        random seed (default 42)\n"
+        "  --walls                         add the two ramps of the demo\n"
+        "  --wall-segments N               add N random short walls\n"
+        "  --sleep                         let resting balls fall asleep\n"
+        "  --ccd                           continuous collisions for balls moving over their radius per step\n"
+        "  --reorder N                     sort the balls by Morton code every N substeps (default: never)\n"
+        "  --drag K                        velocity damping in 1/s (default 0)\n"
+        "  --attractor X Y STRENGTH        add a point attractor (pixels³/s²)\n"
+        "  --nbody G                       mutual gravity with constant G instead of uniform gravity\n"
+        "  --theta T                       Barnes–Hut opening angle for --nbody (default 0.5, at most 0.7)\n"
+        "  --profile                       print the average time per step of every phase\n"
+        "  --trace FILE                    write a Chrome trace of the run to FILE\n"
+        "  --load FILE                     start from a snapshot\n"
+        "  --save FILE                     write a snapshot of the final state\n"
+        "  --replay FILE                   replay the shots, seed and rates of a recorded run\n");
+}
+
+static bool parseArguments(int argc, char* argv[], Scenario& scenario)
+{
+    for (int i{1}; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--integrator")          scenario.integrator   = next();
+        else if (arg == "--tolerance")      scenario.tolerance    = std::strtof(next(), nullptr);
+        else if (arg == "--threads")        scenario.threads      = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--jobs")           scenario.jobs         = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--chunk")          scenario.chunk        = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--strip")          scenario.strip        = std::atoi(next());
+        else if (arg == "--balls")          scenario.balls        = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--steps")          scenario.steps        = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--substeps") {
+            scenario.substeps       = std::max(1ul, std::strtoul(next(), nullptr, 10));
+            scenario.substeps_given = true;
+        }
+        else if (arg == "--rate") {
+            scenario.physics_rate = std::strtof(next(), nullptr);
+            scenario.rate_given   = true;
+        }
+        else if (arg == "--spawn-delay")    scenario.spawn_delay  = std::strtof(next(), nullptr);
+        else if (arg == "--burst")          scenario.burst        = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--lifetime")       scenario.lifetime     = std::strtof(next(), nullptr);
+        else if (arg == "--seed") {
+            scenario.seed       = std::strtoul(next(), nullptr, 10);
+            scenario.seed_given = true;
+        }
+        else if (arg == "--walls")          scenario.walls        = true;
+        else if (arg == "--wall-segments")  scenario.wall_segments = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--profile")        scenario.profile      = true;
+        else if (arg == "--sleep")          scenario.sleep        = true;
+        else if (arg == "--ccd")            scenario.ccd          = true;
+        else if (arg == "--reorder")        scenario.reorder      = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--relaxation")     scenario.relaxation   = std::strtof(next(), nullptr);
+        else if (arg == "--drag")           scenario.drag         = std::strtof(next(), nullptr);
+        else if (arg == "--nbody")          scenario.nbody        = std::strtof(next(), nullptr);
+        else if (arg == "--theta")          scenario.theta        = std::strtof(next(), nullptr);
+        else if (arg == "--trace")          scenario.trace        = next();
+        else if (arg == "--load")           scenario.load         = next();
+        else if (arg == "--save")           scenario.save         = next();
+        else if (arg == "--replay")         scenario.replay       = next();
+        else if (arg == "--attractor") {
+            Attractor attractor;
+            attractor.center.x = std::strtof(next(), nullptr);
+            attractor.center.y = std::strtof(next(), nullptr);
+            attractor.strength = std::strtof(next(), nullptr);
+            scenario.attractors.push_back(attractor);
+        }
+        else if (arg == "--boulders") {
+            scenario.boulders       = std::strtoul(next(), nullptr, 10);
+            scenario.boulder_radius = std::strtof(next(), nullptr);
+        }
+        else if (arg == "--radius") {
+            scenario.min_radius = std::strtof(next(), nullptr);
+            scenario.max_radius = std::strtof(next(), nullptr);
+        }
+        else if (arg == "--broadphase") {
+            const std::string mode = next();
+            if (mode == "brute")            scenario.broad_phase = BroadPhase::BruteForce;
+            else if (mode == "grid")        scenario.broad_phase = BroadPhase::Grid;
+            else if (mode == "parallel")    scenario.broad_phase = BroadPhase::ParallelGrid;
+            else if (mode == "sap")         scenario.broad_phase = BroadPhase::SweepAndPrune;
+            else if (mode == "hgrid")       scenario.broad_phase = BroadPhase::HierarchicalGrid;
+            else {
+                std::fprintf(stderr, "unknown broadphase %s\n", mode.c_str());
+                return false;
+            }
+        }
+        else if (arg == "--contacts") {
+            const std::string mode = next();
+            if (mode == "gauss")            scenario.contact_solver = ContactSolver::GaussSeidel;
+            else if (mode == "colored")     scenario.contact_solver = ContactSolver::Colored;
+            else if (mode == "jacobi")      scenario.contact_solver = ContactSolver::Jacobi;
+            else {
+                std::fprintf(stderr, "unknown contact solver %s\n", mode.c_str());
+                return false;
+            }
+        }
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        }
+        else {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// A replay runs with the seed and rates it was recorded with, flags that say otherwise are refused
+static bool applyReplayHeader(Scenario& scenario)
+{
+    ReplayLog replay;
+    if (!replay.load(scenario.replay)) {
+        std::fprintf(stderr, "could not read replay %s\n", scenario.replay.c_str());
+        return false;
+    }
+    const ReplayHeader& header = replay.getHeader();
+    bool agrees = true;
+    if (scenario.seed_given && scenario.seed != header.seed) {
+        std::fprintf(stderr, "--seed %u differs from the replay's seed %u\n", scenario.seed, header.seed);
+        agrees = false;
+    }
+    if (scenario.substeps_given && scenario.substeps != header.substeps) {
+        std::fprintf(stderr, "--substeps %u differs from the replay's %u\n", scenario.substeps, header.substeps);
+        agrees = false;
+    }
+    if (scenario.rate_given && scenario.physics_rate != header.physics_rate) {
+        std::fprintf(stderr, "--rate %g differs from the replay's %g\n", scenario.physics_rate, header.physics_rate);
+        agrees = false;
+    }
+    scenario.seed         = header.seed;
+    scenario.substeps     = std::max(1u, header.substeps);
+    scenario.physics_rate = header.physics_rate;
+    return agrees;
+}
+
+template <typename T>
+static int run(const Scenario& scenario)
+{
+    utils::Random randomizer(scenario.seed);
+
+    std::vector<Wall> walls;
+    if (scenario.walls) {
+        walls.emplace_back(Vec2{500.f, 350.f}, 300.f, 5.f, -45.f);
+        walls.emplace_back(Vec2{275.f, 400.f}, 300.f, 5.f, 30.f);
+    }
+    utils::Random wall_randomizer(scenario.seed + 1);
+    for (uint32_t i{0}; i < scenario.wall_segments; ++i) {
+        const Scalar x = randomScalar(wall_randomizer, 0.f, static_cast<float>(width));
+        const Scalar y = randomScalar(wall_randomizer, 0.f, static_cast<float>(height));
+        walls.emplace_back(Vec2{x, y}, randomScalar(wall_randomizer, 10.f, 40.f), 2.f,
+                           randomScalar(wall_randomizer, 0.f, 360.f));
+    }
+
+    const float step_size = 1.f / scenario.physics_rate;
+
+    ParticleStore<T> balls;
+    balls.reserve(scenario.balls + scenario.boulders);
+    balls.setStepSize(step_size / scenario.substeps);
+
+    ReplayLog replay;
+    if (!scenario.replay.empty() && !replay.load(scenario.replay)) {
+        std::fprintf(stderr, "could not read replay %s\n", scenario.replay.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Same stream as the windowed demo, spawn_delay rounded to whole steps
+    Spawner spawner(scenario.seed);
+    spawner.min_radius = scenario.min_radius;
+    spawner.max_radius = scenario.max_radius;
+    spawner.max_balls  = scenario.balls;
+    spawner.interval   = std::max(1u, static_cast<uint32_t>(std::lround(scenario.spawn_delay * scenario.physics_rate)));
+    spawner.burst      = scenario.burst;
+    spawner.lifetime   = static_cast<uint32_t>(std::lround(scenario.lifetime * scenario.physics_rate));
+
+    uint64_t first_step = 0;
+    if (!scenario.load.empty()) {
+        std::string rng_state;
+        if (!Snapshot::load(scenario.load, balls, walls, first_step, rng_state)) {
+            std::fprintf(stderr, "could not load snapshot %s\n", scenario.load.c_str());
+            return EXIT_FAILURE;
+        }
+        spawner.setState(rng_state, balls);
+        balls.setStepSize(step_size / scenario.substeps);
+    }
+    // The shots are keyed by step, so a replay starts on the step it was recorded from
+    if (replay.isReplaying() && first_step != replay.getHeader().start_step) {
+        std::fprintf(stderr, "replay %s starts at step %llu, %s at step %llu (--load the snapshot it was recorded from)\n",
+                     scenario.replay.c_str(), static_cast<unsigned long long>(replay.getHeader().start_step),
+                     scenario.load.empty() ? "a fresh run starts" : "the snapshot is",
+                     static_cast<unsigned long long>(first_step));
+        return EXIT_FAILURE;
+    }
+    else if (scenario.spawn_delay <= 0.f) {
+        for (uint32_t i{0}; i < scenario.balls; ++i) {
+            const Scalar x = randomScalar(randomizer, scenario.max_radius, width - scenario.max_radius);
+            const Scalar y = randomScalar(randomizer, scenario.max_radius, height - scenario.max_radius);
+            const Scalar radius = randomScalar(randomizer, scenario.min_radius, scenario.max_radius);
+            balls.emplace_back(radius, {x, y}, 0.f, 0.f);
+        }
+    }
+    if (scenario.load.empty()) {
+        const float r = scenario.boulder_radius;
+        for (uint32_t i{0}; i < scenario.boulders; ++i) {
+            const Scalar x = randomScalar(randomizer, r, width - r);
+            const Scalar y = randomScalar(randomizer, r, height - r);
+            balls.emplace_back(r, {x, y}, 0.f, 0.f);
+        }
+        spawner.max_balls += scenario.boulders;
+    }
+    const bool streaming = scenario.spawn_delay > 0.f;
+
+    balls.setSleeping(scenario.sleep);
+
+    // Walls are static for the whole run, baked once
+    const WallTree wall_tree(walls);
+
+    std::unique_ptr<JobSystem> jobs;
+    std::unique_ptr<StepGraph<T, WallTree>> step_graph;
+    if (scenario.jobs > 0) {
+        jobs       = std::make_unique<JobSystem>(scenario.jobs);
+        step_graph = std::make_unique<StepGraph<T, WallTree>>(balls, wall_tree);
+        step_graph->setBallsPerTask(scenario.chunk);
+        step_graph->setColumnsPerStrip(scenario.strip);
+    }
+
+    float simulated_time = first_step * step_size;
+    uint64_t particle_updates = 0;
+    PairStats pairs;
+    uint64_t swept_hits = 0;
+
+    utils::Profiler& profiler = utils::Profiler::instance();
+    if (!scenario.trace.empty()) profiler.startTrace();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t step{first_step}; step < first_step + scenario.steps; ++step) {
+        {
+            PROFILE_SCOPE("spawning");
+            replay.apply(balls, step);
+            if (streaming) spawner.update(balls, step, step * step_size);
+        }
+
+        for (uint32_t s{0}; s < scenario.substeps; ++s) {
+            if (step_graph) {
+                PROFILE_SCOPE("step graph");
+                step_graph->step(*jobs);
+            } else {
+                {
+                    PROFILE_SCOPE("forces");
+                    Forces::accumulate(balls);
+                }
+                {
+                    PROFILE_SCOPE("integration");
+                    balls.updatePositions();
+                }
+                Solver::resolveCollisions<T>(balls, wall_tree);
+            }
+            pairs.tested    += Solver::getPairStats().tested;
+            pairs.colliding += Solver::getPairStats().colliding;
+            swept_hits      += Solver::getSweptHits();
+        }
+        particle_updates += static_cast<uint64_t>(balls.size()) * scenario.substeps;
+        simulated_time += step_size;
+        profiler.endFrame();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!scenario.save.empty()
+        && !Snapshot::save(scenario.save, balls, walls, first_step + scenario.steps, spawner.getState(balls))) {
+        std::fprintf(stderr, "could not write snapshot %s\n", scenario.save.c_str());
+    }
+
+    if (!scenario.trace.empty() && !profiler.stopTrace(scenario.trace)) {
+        std::fprintf(stderr, "could not write %s\n", scenario.trace.c_str());
+    }
+
+    // Order dependent sum of the final state, equal across runs of the same scenario and build
+    double checksum = 0.0;
+    for (size_t i{0}; i < balls.size(); ++i) {
+        checksum += (i + 1) * (static_cast<double>(balls.x[i]) + 3.0 * static_cast<double>(balls.y[i]));
+    }
+
+    std::printf("integrator          %s (%s kernel)\n", scenario.integrator.c_str(),
+                std::is_same_v<T, VerletBall> && std::is_same_v<Scalar, float> ? simd::toString(simd::getIsa()) : "scalar");
+    std::printf("physics scalar      %s\n", scalarName());
+    std::printf("broadphase          %s (%zu threads)\n", toString(scenario.broad_phase),
+                scenario.broad_phase == BroadPhase::ParallelGrid ? Solver::getThreadCount() : size_t{1});
+    if (scenario.contact_solver != ContactSolver::GaussSeidel) {
+        std::printf("contacts            %s (%zu threads)\n", toString(scenario.contact_solver), Solver::getThreadCount());
+    }
+    if (jobs) {
+        std::printf("step graph          %zu threads, %zu balls/task, %d columns/strip\n", jobs->size(),
+                    step_graph->getBallsPerTask(), step_graph->getColumnsPerStrip());
+    }
+    if (scenario.broad_phase == BroadPhase::HierarchicalGrid) {
+        const HierarchicalGrid& hierarchy = Solver::getHierarchy();
+        std::printf("grid levels        ");
+        for (int k{0}; k < hierarchy.getLevelCount(); ++k) std::printf(" %zu", hierarchy.getLevelSize(k));
+        std::printf(" balls\n");
+    }
+    std::printf("balls               %zu (%zu asleep, %llu despawned)\n", balls.size(), balls.getSleepingCount(),
+                static_cast<unsigned long long>(spawner.getDespawnCount()));
+    std::printf("steps               %u x %u substeps, dt %g s\n", scenario.steps, scenario.substeps, step_size);
+    std::printf("simulated time      %.3f s\n", simulated_time);
+    std::printf("wall time           %.3f s\n", seconds);
+    std::printf("steps/s             %.1f\n", scenario.steps / seconds);
+    std::printf("particle-updates/s  %.4g\n", particle_updates / seconds);
+    if constexpr (ParticleStore<T>::adaptive) {
+        std::printf("field evals/update  %.2f\n",
+                    particle_updates > 0 ? static_cast<double>(dormand_prince::evaluations) / particle_updates : 0.0);
+    }
+    std::printf("pairs tested/step   %.1f\n", static_cast<double>(pairs.tested) / scenario.steps);
+    std::printf("pairs colliding     %.1f%% of tested\n",
+                pairs.tested > 0 ? 100.0 * pairs.colliding / pairs.tested : 0.0);
+    if (scenario.ccd) std::printf("swept hits/step     %.2f\n", static_cast<double>(swept_hits) / scenario.steps);
+    std::printf("checksum            %.6f\n", checksum);
+
+    if (jobs) {
+        char utilization[2048];
+        jobs->format(utilization, sizeof(utilization));
+        std::printf("\n%s", utilization);
+    }
+
+    if (scenario.profile) {
+        std::printf("\nphase               ms/step\n");
+        for (size_t i{0}; i < profiler.getPhaseCount(); ++i) {
+            const auto& phase = profiler.getPhase(i);
+            std::printf("%-18s  %.4f\n", phase.name, phase.total_ms / profiler.getFrameCount());
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    Scenario scenario;
+    if (!parseArguments(argc, argv, scenario)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    if (!scenario.replay.empty() && !applyReplayHeader(scenario)) return EXIT_FAILURE;
+
+    Solver::setBroadPhase(scenario.broad_phase);
+    Solver::setContinuous(scenario.ccd);
+    Solver::setReorderInterval(scenario.reorder);
+    Solver::setContactSolver(scenario.contact_solver);
+    Solver::setJacobiRelaxation(scenario.relaxation);
+    if (scenario.threads > 0) {
+        Solver::setThreadCount(scenario.threads);
+        Forces::setThreadCount(scenario.threads);
+    }
+
+    Forces::setDrag(scenario.drag);
+    for (const Attractor& attractor : scenario.attractors) Forces::addAttractor(attractor);
+    if (scenario.nbody > 0.f) {
+        Gravitation gravitation;
+        gravitation.enabled  = true;
+        gravitation.constant = scenario.nbody;
+        gravitation.theta    = scenario.theta;
+        Forces::setGravitation(gravitation);
+        Forces::setUniform({0.f, 0.f});
+    }
+
+    if (scenario.integrator == "verlet") return run<VerletBall>(scenario);
+    if (scenario.integrator == "euler")  return run<EulerBall>(scenario);
+    if (scenario.integrator == "implicit") return run<ImplicitEulerBall>(scenario);
+    if (scenario.integrator == "rk4")    return run<RK4Ball>(scenario);
+    if (scenario.integrator == "rk45") {
+        dormand_prince::settings.tolerance = scenario.tolerance;
+        return run<RK45Ball>(scenario);
+    }
+
+    std::fprintf(stderr, "unknown integrator %s\n", scenario.integrator.c_str());
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,365 @@
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#define HAVE_SFML
+#include "utils/random.h"
+#include "headers/verlet.h"
+#include "headers/explicit_euler.h"
+#include "headers/implicit_euler.h"
+#include "headers/rk4.h"
+#include "headers/rk45.h"
+
+// Integrator comparison: every ball type integrates the same particles through a field with a
+// known solution, without collisions, and one CSV row is printed per field, integrator and step size.
+//
+//   integrators --dt 0.0333,0.0167,0.0083 --duration 4 --budget 1 --out integrators.csv
+//
+// position_error   largest distance in pixels from the analytic solution at the end
+// energy_drift     largest difference of kinetic plus potential energy from the analytic solution at the
+//                  end, relative to the particle's initial kinetic plus absolute potential energy
+// ns_per_step      wall time of updatePositions per particle and step, the best of --repeat runs after an
+//                  untimed one, so that no row pays for cold caches and page faults
+// unconverged      particle steps of implicit whose Newton iteration did not converge (backward_euler), such
+//                  a row is not the backward Euler solution and is never picked by --budget
+
+enum class Field { Projectile, Drag, Stiff, Orbit };
+
+static const char* toString(Field field)
+{
+    switch (field) {
+    case Field::Projectile: return "projectile";
+    case Field::Drag:       return "drag";
+    case Field::Stiff:      return "stiff";
+    case Field::Orbit:      return "orbit";
+    }
+    return "";
+}
+
+struct Options {
+    std::vector<Field> fields = {Field::Projectile, Field::Drag, Field::Stiff, Field::Orbit};
+    std::vector<std::string> integrators = {"euler", "implicit", "verlet", "rk4", "rk45"};
+    std::vector<double> step_sizes = {1.0 / 30, 1.0 / 60, 1.0 / 120, 1.0 / 240, 1.0 / 480};
+    double duration   = 4.0;        // simulated seconds
+    uint32_t particles = 1000;
+    double drag       = 1.0;        // 1/s, drag field
+    double stiff_drag = 100.0;      // 1/s, stiff field, explicit integrators blow up once it passes ~2 / dt
+    double tolerance  = 0.01;       // rk45 local error per step, in pixels
+    double budget     = 0.0;        // pixels, report the cheapest row within it per field, 0 = off
+    unsigned int seed = 42;
+    uint32_t repeat   = 3;          // timed runs per row, the fastest one is reported
+    std::string out;                // CSV file, stdout when empty
+};
+
+struct Kinematics {
+    double x, y, vx, vy;
+};
+
+struct Row {
+    std::string integrator;
+    double dt             = 0.0;
+    uint32_t steps        = 0;
+    double position_error = 0.0;
+    double energy_drift   = 0.0;
+    double ns_per_step    = 0.0;
+    uint64_t unconverged  = 0;
+};
+
+// Circular orbits around a softened point mass in the middle of the window
+constexpr double ORBIT_STRENGTH  = 1e7;     // pixels³/s²
+constexpr double ORBIT_SOFTENING = 10.0;    // pixels
+constexpr double ORBIT_X = 500.0, ORBIT_Y = 500.0;
+
+static double gravityX() { return static_cast<double>(ACCELERATION.x);}
+static double gravityY() { return static_cast<double>(ACCELERATION.y);}
+
+static double dragOf(Field field, const Options& options)
+{
+    if (field == Field::Drag)  return options.drag;
+    if (field == Field::Stiff) return options.stiff_drag;
+    return 0.0;
+}
+
+static void configure(Field field, const Options& options)
+{
+    Forces::reset();
+    Forces::setDrag(Scalar(dragOf(field, options)));
+    if (field == Field::Orbit) {
+        Forces::setUniform({0.f, 0.f});
+        Attractor attractor;
+        attractor.center    = {Scalar(ORBIT_X), Scalar(ORBIT_Y)};
+        attractor.strength  = Scalar(ORBIT_STRENGTH);
+        attractor.softening = Scalar(ORBIT_SOFTENING);
+        Forces::addAttractor(attractor);
+    }
+}
+
+// Where a particle starting in state s is after t seconds
+static Kinematics exact(Field field, const Options& options, const Kinematics& s, double t)
+{
+    const double gx = gravityX(), gy = gravityY();
+    switch (field) {
+    case Field::Projectile:
+        return {s.x + s.vx * t + 0.5 * gx * t * t, s.y + s.vy * t + 0.5 * gy * t * t, s.vx + gx * t, s.vy + gy * t};
+    case Field::Drag:
+    case Field::Stiff: {
+        // The velocity relaxes exponentially towards the terminal velocity g / k
+        const double k = dragOf(field, options);
+        const double decay = std::exp(-k * t);
+        const double tx = gx / k, ty = gy / k;
+        return {s.x + tx * t + (s.vx - tx) * (1.0 - decay) / k, s.y + ty * t + (s.vy - ty) * (1.0 - decay) / k,
+                tx + (s.vx - tx) * decay, ty + (s.vy - ty) * decay};
+    }
+    case Field::Orbit: {
+        // Rotation at constant angular speed about the centre
+        const double rx = s.x - ORBIT_X, ry = s.y - ORBIT_Y;
+        const double omega = (rx * s.vy - ry * s.vx) / (rx * rx + ry * ry);
+        const double c = std::cos(omega * t), sn = std::sin(omega * t);
+        return {ORBIT_X + rx * c - ry * sn, ORBIT_Y + rx * sn + ry * c, s.vx * c - s.vy * sn, s.vx * sn + s.vy * c};
+    }
+    }
+    return s;
+}
+
+static double kinetic(const Kinematics& s) { return 0.5 * (s.vx * s.vx + s.vy * s.vy);}
+
+static double potential(Field field, const Kinematics& s)
+{
+    if (field == Field::Orbit) return -ORBIT_STRENGTH / std::hypot(s.x - ORBIT_X, s.y - ORBIT_Y, ORBIT_SOFTENING);
+    return -(gravityX() * s.x + gravityY() * s.y);
+}
+
+template <typename T>
+static Kinematics kinematics(const ParticleStore<T>& balls, size_t i)
+{
+    const Vec2 position = balls.getPosition(i), velocity = balls.getVelocity(i);
+    return {static_cast<double>(position.x), static_cast<double>(position.y),
+            static_cast<double>(velocity.x), static_cast<double>(velocity.y)};
+}
+
+template <typename T>
+static void spawn(Field field, const Options& options, ParticleStore<T>& balls)
+{
+    utils::Random randomizer(options.seed);
+    for (uint32_t i{0}; i < options.particles; ++i) {
+        if (field == Field::Orbit) {
+            const float r     = randomizer.generateRandomFloat(150.f, 350.f);
+            const float phase = randomizer.generateRandomFloat(0.f, 2.f * PI_f);
+            // v² / r = strength r / (r² + softening²)^3/2
+            const double orbit_speed = r * std::sqrt(ORBIT_STRENGTH / std::pow(r * r + ORBIT_SOFTENING * ORBIT_SOFTENING, 1.5));
+            const float speed = static_cast<float>(orbit_speed) / static_cast<float>(SCALE);
+            balls.emplace_back(5.f, {static_cast<float>(ORBIT_X) + r * std::cos(phase),
+                                     static_cast<float>(ORBIT_Y) + r * std::sin(phase)}, speed, phase + 0.5f * PI_f);
+        } else {
+            const float x     = randomizer.generateRandomFloat(100.f, 900.f);
+            const float y     = randomizer.generateRandomFloat(100.f, 900.f);
+            const float speed = randomizer.generateRandomFloat(0.f, 5.f);
+            const float angle = randomizer.generateRandomFloat(0.f, 2.f * PI_f);
+            balls.emplace_back(5.f, {x, y}, speed, angle);
+        }
+    }
+}
+
+// Keeps NaN, a blown up integrator must not look accurate
+static void keepWorst(double& worst, double value)
+{
+    if (!(value <= worst)) worst = value;
+}
+
+template <typename T>
+static Row measure(Field field, double dt, const Options& options)
+{
+    configure(field, options);
+    ParticleStore<T> balls;
+    balls.reserve(options.particles);
+    balls.setStepSize(Scalar(dt));
+    spawn(field, options, balls);
+
+    std::vector<Kinematics> start(balls.size());
+    for (size_t i{0}; i < balls.size(); ++i) start[i] = kinematics(balls, i);
+
+    Row row;
+    row.dt    = dt;
+    row.steps = static_cast<uint32_t>(std::max(1l, std::lround(options.duration / dt)));
+
+    // Every run starts from the same particles and ends in the same state, the last one is measured
+    const ParticleStore<T> initial = balls;
+    double seconds = 0.0;
+    for (uint32_t run{0}; run <= options.repeat; ++run) {
+        balls = initial;
+        backward_euler::unconverged = 0;
+        const auto begin = std::chrono::steady_clock::now();
+        for (uint32_t n{0}; n < row.steps; ++n) balls.updatePositions();
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (run == 1 || (run > 1 && elapsed < seconds)) seconds = elapsed;
+    }
+    row.ns_per_step = 1e9 * seconds / (static_cast<double>(row.steps) * balls.size());
+    row.unconverged = backward_euler::unconverged.load();
+
+    for (size_t i{0}; i < balls.size(); ++i) {
+        const Kinematics reached  = kinematics(balls, i);
+        const Kinematics expected = exact(field, options, start[i], row.steps * dt);
+        const double scale = kinetic(start[i]) + std::abs(potential(field, start[i]));
+        keepWorst(row.position_error, std::hypot(reached.x - expected.x, reached.y - expected.y));
+        keepWorst(row.energy_drift, std::abs(kinetic(reached) + potential(field, reached)
+                                             - kinetic(expected) - potential(field, expected)) / scale);
+    }
+    Forces::reset();
+    return row;
+}
+
+static bool measure(const std::string& integrator, Field field, double dt, const Options& options, Row& row)
+{
+    if (integrator == "euler")          row = measure<EulerBall>(field, dt, options);
+    else if (integrator == "implicit")  row = measure<ImplicitEulerBall>(field, dt, options);
+    else if (integrator == "verlet")    row = measure<VerletBall>(field, dt, options);
+    else if (integrator == "rk4")       row = measure<RK4Ball>(field, dt, options);
+    else if (integrator == "rk45")      row = measure<RK45Ball>(field, dt, options);
+    else return false;
+    row.integrator = integrator;
+    return true;
+}
+
+static void printUsage()
+{
+    std::printf(
+        "usage: integrators [options]\n"
+        "  --fields LIST         projectile,drag,stiff,orbit (default all)\n"
+        "  --integrators LIST    euler,implicit,verlet,rk4,rk45 (default all)\n"
+        "  --dt LIST             step sizes in seconds (default 1/30,1/60,1/120,1/240,1/480)\n"
+        "  --duration S          simulated seconds per run (default 4)\n"
+        "  --particles N         particles per run (default 1000)\n"
+        "  --drag K              damping of the drag field in 1/s (default 1)\n"
+        "  --stiff-drag K        damping of the stiff field in 1/s (default 100)\n"
+        "  --tolerance PX        rk45 local error allowed per step (default 0.01)\n"
+        "  --budget PX           print the cheapest run within PX of the solution per field\n"
+        "  --seed N              random seed (default 42)\n"
+        "  --repeat N            timed runs per row after an untimed one, the fastest counts (default 3)\n"
+        "  --out FILE            write the CSV to FILE instead of stdout\n");
+}
+
+static std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        const size_t end = std::min(list.find(',', begin), list.size());
+        if (end > begin) items.push_back(list.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return items;
+}
+
+static bool parseArguments(int argc, char* argv[], Options& options)
+{
+    for (int i{1}; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--integrators")     options.integrators = split(next());
+        else if (arg == "--duration")   options.duration    = std::strtod(next(), nullptr);
+        else if (arg == "--particles")  options.particles   = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--drag")       options.drag        = std::strtod(next(), nullptr);
+        else if (arg == "--stiff-drag") options.stiff_drag  = std::strtod(next(), nullptr);
+        else if (arg == "--tolerance")  options.tolerance   = std::strtod(next(), nullptr);
+        else if (arg == "--budget")     options.budget      = std::strtod(next(), nullptr);
+        else if (arg == "--seed")       options.seed        = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--repeat")     options.repeat      = std::max(1ul, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--out")        options.out         = next();
+        else if (arg == "--dt") {
+            options.step_sizes.clear();
+            for (const std::string& item : split(next())) options.step_sizes.push_back(std::strtod(item.c_str(), nullptr));
+        }
+        else if (arg == "--fields") {
+            options.fields.clear();
+            for (const std::string& item : split(next())) {
+                if (item == "projectile")   options.fields.push_back(Field::Projectile);
+                else if (item == "drag")    options.fields.push_back(Field::Drag);
+                else if (item == "stiff")   options.fields.push_back(Field::Stiff);
+                else if (item == "orbit")   options.fields.push_back(Field::Orbit);
+                else {
+                    std::fprintf(stderr, "unknown field %s\n", item.c_str());
+                    return false;
+                }
+            }
+        }
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        }
+        else {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    for (double dt : options.step_sizes) {
+        if (!(dt > 0.0)) {
+            std::fprintf(stderr, "step sizes must be positive\n");
+            return false;
+        }
+    }
+    return options.particles > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    dormand_prince::settings.tolerance = Scalar(options.tolerance);
+
+    FILE* out = options.out.empty() ? stdout : std::fopen(options.out.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "could not write %s\n", options.out.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::fprintf(out, "field,integrator,scalar,dt,steps,particles,position_error,energy_drift,ns_per_step,unconverged\n");
+    for (Field field : options.fields) {
+        const Row* cheapest = nullptr;
+        std::vector<Row> rows;
+        rows.reserve(options.integrators.size() * options.step_sizes.size());
+        for (const std::string& integrator : options.integrators) {
+            for (double dt : options.step_sizes) {
+                Row row;
+                if (!measure(integrator, field, dt, options, row)) {
+                    std::fprintf(stderr, "unknown integrator %s\n", integrator.c_str());
+                    return EXIT_FAILURE;
+                }
+                std::fprintf(out, "%s,%s,%s,%.6g,%u,%u,%.6g,%.6g,%.2f,%llu\n", toString(field), row.integrator.c_str(),
+                             scalarName(), row.dt, row.steps, options.particles, row.position_error,
+                             row.energy_drift, row.ns_per_step, static_cast<unsigned long long>(row.unconverged));
+                std::fflush(out);
+                rows.push_back(row);
+            }
+        }
+
+        // Cost of simulating one particle for one second
+        auto cost = [](const Row& row) { return row.ns_per_step / row.dt;};
+        for (const Row& row : rows) {
+            if (row.unconverged > 0 || row.position_error > options.budget) continue;
+            if (!cheapest || cost(row) < cost(*cheapest)) cheapest = &row;
+        }
+        if (options.budget <= 0.0) continue;
+        if (cheapest) {
+            std::fprintf(stderr, "%-10s  cheapest within %g px: %s at dt %.6g (%.1f ns per particle-second)\n",
+                         toString(field), options.budget, cheapest->integrator.c_str(), cheapest->dt, cost(*cheapest));
+        } else {
+            std::fprintf(stderr, "%-10s  no run within %g px\n", toString(field), options.budget);
+        }
+    }
+
+    if (out != stdout) std::fclose(out);
+    return EXIT_SUCCESS;
+}
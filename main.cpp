@@ -1,96 +1,261 @@
 #include <SFML/Graphics.hpp>
 #include <iostream>
 #include <vector>
-#include <sstream>
-#include <iomanip>
-#define HAVE_SFML
-#include "utils/random.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cstdlib>
+#include <thread>
 #include "headers/solver.h"
+#include "headers/scheduler.h"
+#include "headers/simulation_thread.h"
+#include "headers/job_system.h"
+#include "headers/step_graph.h"
+#include "headers/triple_buffer.h"
+#include "headers/render_frame.h"
+#include "headers/spawner.h"
+#include "headers/snapshot.h"
+#include "headers/replay.h"
+#include "utils/profiler.h"
+#include "utils/alloc_counter.h"
 #include "event.h"
 
 constexpr int windowWidth  = 1000;
 constexpr int windowHeight = 1000;
 constexpr int frameRate    = 120;
+constexpr float physicsRate = 120.f;    // physics steps per second, independent of frameRate
+constexpr uint32_t substeps = 1;        // integration + collision passes per physics step
+constexpr float hudRate     = 4.f;      // HUD text refreshes per second
+constexpr uint32_t settleFrames = 4;    // quiet frames before a frame must not allocate
+constexpr uint64_t utilizationSteps = 120;  // physics steps the worker utilization is averaged over
 
-static sf::Color getRainbow(float t)
-{
-    const float r = sin(t);
-    const float g = sin(t + 0.33f * 2.0f * PI_f);
-    const float b = sin(t + 0.66f * 2.0f * PI_f);
-    return {static_cast<uint8_t>(255.0f * r * r),
-            static_cast<uint8_t>(255.0f * g * g),
-            static_cast<uint8_t>(255.0f * b * b)};
-}
+const std::string snapshotFile = "snapshot.bin";
 
+// main [--seed N] [--load SNAPSHOT] [--record FILE | --replay FILE]
+// F5 saves the current state to snapshot.bin, F9 loads it back.
+// The physics runs on a thread of its own and hands frames to this one through a triple buffer,
+// input reaches it as commands run between its steps. Each substep is a graph of phases run by a
+// work-stealing job system on the simulation thread and its workers, the last one packs the frame.
 int main(int argc, char* argv[]) {
+    unsigned int seed = static_cast<unsigned int>(std::time(nullptr));
+    std::string load_path, record_path, replay_path;
+    for (int i{1}; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--seed")        seed        = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (arg == "--load")   load_path   = argv[i + 1];
+        else if (arg == "--record") record_path = argv[i + 1];
+        else if (arg == "--replay") replay_path = argv[i + 1];
+    }
+
+    // A replay runs with the seed and rates it was recorded with
+    ReplayLog replay;
+    float physics_rate = physicsRate;
+    uint32_t physics_substeps = substeps;
+    if (!replay_path.empty()) {
+        if (!replay.load(replay_path)) {
+            std::cerr << "Could not read replay " << replay_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        seed             = replay.getHeader().seed;
+        physics_rate     = replay.getHeader().physics_rate;
+        physics_substeps = replay.getHeader().substeps;
+    }
+    std::cout << "Seed " << seed << std::endl;
+
     sf::RenderWindow window(sf::VideoMode(windowWidth, windowHeight), "Simple Physics Engine");
     window.setFramerateLimit(frameRate);
     EventHandler HandleEvent(window);
 
-    // Utilities
-    utils::Random randomizer;
-
     // Define walls: starting pos, length, thickness, angle
     Wall ramp1({500.f, 350.f}, 300.f, 5.f, -45.f);
     Wall ramp2({275.f, 400.f}, 300.f, 5.f, 30.f);
     std::vector<Wall> walls{ramp1, ramp2};
     
-    // Initialize ball settings
-    std::vector<VerletBall> balls;
-    const float spawn_delay          = 0.025f;
-    const float initial_speed        = 10.f;              // Ball speed in m/s
-    const sf::Vector2f spawn_position{40.f, 150.f};
-    const uint32_t max_balls         = 1200;
-    balls.reserve(max_balls);
-
-    // FPS calculations
+    // Initialize ball settings, a ball every 3 physics steps (0.025 s at 120 Hz)
+    ParticleStore<VerletBall> balls;
+    Spawner spawner(seed);
+    balls.reserve(spawner.max_balls);
+    Solver::reserve(spawner.max_balls);
+    balls.setSleeping(true);
+    Solver::setContinuous(true);    // shots can be fast enough to pass through the balls in their way
+
+    // Physics runs on its own fixed clock, on the simulation thread
+    FixedStepScheduler scheduler(physics_rate, physics_substeps);
+    balls.setStepSize(scheduler.getSubstepSize());
+
+    auto save_snapshot = [&](const std::string& path) {
+        if (Snapshot::save(path, balls, walls, scheduler.getStepCount(), spawner.getState(balls))) {
+            std::cout << "Snapshot written to " << path << std::endl;
+        }
+    };
+    auto load_snapshot = [&](const std::string& path) {
+        uint64_t step = 0;
+        std::string rng_state;
+        if (!Snapshot::load(path, balls, walls, step, rng_state)) {
+            std::cerr << "Could not load snapshot " << path << std::endl;
+            return false;
+        }
+        scheduler.setStepCount(step);
+        spawner.setState(rng_state, balls);
+        balls.setStepSize(scheduler.getSubstepSize());
+        return true;
+    };
+    if (!load_path.empty() && !load_snapshot(load_path)) return EXIT_FAILURE;
+
+    if (!record_path.empty()) {
+        ReplayHeader header;
+        header.seed         = seed;
+        header.physics_rate = physics_rate;
+        header.substeps     = physics_substeps;
+        header.start_step   = scheduler.getStepCount();
+        if (!replay.startRecording(record_path, header)) {
+            std::cerr << "Could not write replay " << record_path << std::endl;
+        }
+    }
+
+    // One core is left to this thread for drawing
+    JobSystem jobs(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    const std::vector<Wall> no_walls;      // balls do not collide with the ramps, nor are they drawn
+    StepGraph<VerletBall, std::vector<Wall>> step_graph(balls, no_walls);
+    std::vector<float> utilization(jobs.size(), 0.f);
+    TripleBuffer<RenderFrame> frames;
+
+    // Spawning and user shots happen on physics steps, never on the wall clock
+    auto physics_step = [&]() {
+        const uint64_t step = scheduler.getStepCount();
+        {
+            PROFILE_SCOPE("spawning");
+            replay.apply(balls, step);
+            spawner.update(balls, step, scheduler.getSimulatedTime());
+        }
+        balls.saveRenderState();
+        for (uint32_t s{0}; s < scheduler.getSubsteps(); ++s) {
+            PROFILE_SCOPE("step graph");
+            step_graph.step(jobs, s + 1 == scheduler.getSubsteps() ? &frames.write() : nullptr);
+        }
+    };
+
+    // Everything above belongs to the simulation thread from here on, this thread only reads frames
+    auto publish_frame = [&]() {
+        PROFILE_SCOPE("publishing");
+        if (jobs.getRunCount() >= utilizationSteps * scheduler.getSubsteps()) {
+            for (size_t i{0}; i < jobs.size(); ++i) utilization[i] = static_cast<float>(jobs.getUtilization(i));
+            jobs.resetStats();
+        }
+        RenderFrame& frame = frames.write();
+        frame.stamp(balls, no_walls, scheduler.getStepCount(), scheduler.getStepSize());
+        frame.utilization = utilization;
+        frames.publish();
+    };
+    frames.write().capture(balls, no_walls, scheduler.getStepCount(), scheduler.getStepSize());
+    frames.write().utilization = utilization;
+    frames.publish();
+    frames.update();
+    SimulationThread simulation;
+    simulation.start(scheduler, physics_step, publish_frame);
+
+    // HUD, formatted into fixed buffers and only laid out again when the text changed
     sf::Font font;
     font.loadFromFile("fonts/cmunrm.ttf");
-    float fps = 0.0f, time_per_frame = 0.0f;
+    uint32_t hud_frames  = 0;
+    uint64_t hud_step    = frames.read().step;  // physics steps at the last HUD refresh
+    uint32_t quiet_frames = 0;          // frames in a row without input, spawns or HUD changes
     sf::Text information_text("", font, 25);
+    char hud_text[2048] = "";
+    char hud_next[sizeof(hud_text)];
 
     // Clocks
-    sf::Clock ball_clock, fps_clock, total_time_clock;
+    sf::Clock total_time_clock, hud_clock;
 
     while (window.isOpen()) {
+        bool quiet = !utils::Profiler::instance().isTracing();
+        const size_t ball_count = frames.read().size();
+
         sf::Event event;
         while (window.pollEvent(event)) {
+            quiet = false;
             HandleEvent.closeWindow(event);
-            HandleEvent.dragAndShoot<VerletBall>(event, balls);
+            HandleEvent.handleProfilerKeys(event);
+            // Shots are queued for the step the simulation is at when it gets them
+            HandleEvent.aimAndFire(event, [&](float radius, sf::Vector2f position, float speed, float angle) {
+                simulation.post([&replay, &scheduler, shot = Shot{0, radius, position.x, position.y, speed, angle}]() mutable {
+                    shot.step = scheduler.getStepCount();
+                    replay.record(shot);
+                });
+            });
+            if (event.type != sf::Event::KeyPressed) continue;
+            // The solver settings are only touched between steps
+            simulation.post([&HandleEvent, event]() {
+                HandleEvent.toggleBroadPhase(event);
+                HandleEvent.toggleContactSolver(event);
+            });
+            if (event.key.code == sf::Keyboard::F5) simulation.post([&]() { save_snapshot(snapshotFile);});
+            if (event.key.code == sf::Keyboard::F9) simulation.post([&]() { load_snapshot(snapshotFile);});
         }
 
-        if (balls.size() < max_balls) {
-            if (ball_clock.getElapsedTime().asSeconds() >= spawn_delay) {
-                const float random_radius    = randomizer.generateRandomFloat(2.f, 25.f);
-                float t = total_time_clock.getElapsedTime().asSeconds();
-                const sf::Color random_color = getRainbow(t);
-                balls.emplace_back(random_radius, spawn_position, initial_speed, 0.f * (PI_f / 180.f));
-                balls.back().setColor(random_color);
-                ball_clock.restart();
-            }
-        }
+        const uint64_t allocations = utils::getAllocationCount();
+        frames.update();
+        const RenderFrame& frame = frames.read();
+        const float alpha = frame.alphaAt(RenderFrame::Clock::now());
+        quiet = quiet && frame.size() == ball_count;
 
-        window.clear(sf::Color::Black);
-        HandleEvent.drawDragArrow();
-        //HandleEvent.drawWall(walls);
-        HandleEvent.drawBall(balls);
-        Solver::resolveCollisions<VerletBall>(balls);
+        {
+            PROFILE_SCOPE("rendering");
+            window.clear(sf::Color::Black);
+            HandleEvent.drawScene(frame, alpha);
+        }
 
         // Display text
-        float totalElapsedTime = total_time_clock.getElapsedTime().asSeconds();
-        std::ostringstream oss;
-        oss << std::fixed << std::setprecision(2) << totalElapsedTime;
-        time_per_frame = fps_clock.restart().asSeconds(); // Get time since last frame
-        fps = 1.0f / time_per_frame;
-        std::string FPS           = std::to_string(static_cast<int>(fps)) + " FPS";
-        std::string object_count  = std::to_string(static_cast<int>(balls.size())) + " objects";
-        std::string formatted_time = oss.str() + " sec"; // Convert the formatted string to a regular string
-        information_text.setString(FPS + "\n" + object_count + "\n" + formatted_time);
+        ++hud_frames;
+        const float hud_elapsed = hud_clock.getElapsedTime().asSeconds();
+        if (hud_elapsed >= 1.f / hudRate) {
+            const PairStats& pairs = frame.pairs;
+            int length = std::snprintf(hud_next, sizeof(hud_next), "%d FPS, %d steps/s\n%zu objects, %zu asleep\n%.2f sec\n%s (%s), %llu/%llu pairs",
+                                       static_cast<int>(hud_frames / hud_elapsed),
+                                       static_cast<int>((frame.step - hud_step) / hud_elapsed), frame.size(), frame.asleep,
+                                       total_time_clock.getElapsedTime().asSeconds(), toString(frame.broad_phase),
+                                       toString(frame.contact_solver),
+                                       static_cast<unsigned long long>(pairs.colliding),
+                                       static_cast<unsigned long long>(pairs.tested));
+            length = std::clamp(length, 0, static_cast<int>(sizeof(hud_next)) - 1);
+            length += std::snprintf(hud_next + length, sizeof(hud_next) - length, "\n%zu workers", frame.utilization.size());
+            for (const float busy : frame.utilization) {
+                length = std::clamp(length, 0, static_cast<int>(sizeof(hud_next)) - 1);
+                length += std::snprintf(hud_next + length, sizeof(hud_next) - length, " %d%%", static_cast<int>(100.f * busy));
+            }
+            length = std::clamp(length, 0, static_cast<int>(sizeof(hud_next)) - 1);
+            if (HandleEvent.isProfilerVisible() && length + 1 < static_cast<int>(sizeof(hud_next))) {
+                hud_next[length++] = '\n';
+                length += static_cast<int>(utils::Profiler::instance().format(hud_next + length, sizeof(hud_next) - length));
+                hud_next[std::min(length, static_cast<int>(sizeof(hud_next)) - 1)] = '\0';
+            }
+            if (std::strcmp(hud_next, hud_text) != 0) {
+                std::memcpy(hud_text, hud_next, sizeof(hud_text));
+                information_text.setString(hud_text);
+                quiet = false;
+            }
+            hud_clock.restart();
+            hud_frames = 0;
+            hud_step   = frame.step;
+        }
         window.draw(information_text);
 
-        window.display();
+        // Whatever changed a few frames ago has settled, a steady frame must not touch the heap (debug
+        // builds). Only this thread's allocations count, the simulation thread allocates on its own schedule.
+        quiet_frames = quiet ? quiet_frames + 1 : 0;
+        assert((quiet_frames < settleFrames || utils::getAllocationCount() == allocations)
+               && "heap allocation in a steady frame");
+
+        {
+            PROFILE_SCOPE("display");
+            window.display();
+        }
+        utils::Profiler::instance().endFrame();
     }
 
+    simulation.stop();
     return 0;
 }
 
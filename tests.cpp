@@ -0,0 +1,297 @@
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <string>
+#include <vector>
+#define HAVE_SFML
+#include "headers/forces.h"
+#include "headers/snapshot.h"
+#include "headers/solver.h"
+#include "headers/spawner.h"
+#include "headers/step_graph.h"
+
+// Checks of behaviour the headless runner and the benchmarks cannot see, run by ctest.
+// Every check prints its outcome, the run fails if any of them did not hold.
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    std::printf("%s  %s\n", condition ? "ok  " : "FAIL", what);
+    if (!condition) ++failures;
+}
+
+// Balls resting on the floor, far enough apart not to collide, every one of them asleep
+template <typename T>
+static void settle(ParticleStore<T>& balls)
+{
+    balls.setSleeping(true);
+    for (int step{0}; step < 20; ++step) balls.updateSleep();
+}
+
+// Erasing a ball wakes the sleepers it touched and leaves the rest of the scene asleep
+static void testEraseWakesNeighboursOnly()
+{
+    ParticleStore<VerletBall> balls;
+    const ParticleHandle left   = balls.emplace_back(10.f, {100.f, 990.f}, 0.f, 0.f);
+    const ParticleHandle erased = balls.emplace_back(10.f, {121.f, 990.f}, 0.f, 0.f);
+    const ParticleHandle far    = balls.emplace_back(10.f, {800.f, 990.f}, 0.f, 0.f);
+    settle(balls);
+    check(balls.getSleepingCount() == 3, "erase: scene settles");
+
+    balls.erase(erased);
+    Solver::setBroadPhase(BroadPhase::Grid);
+    Solver::resolveCollisions<VerletBall>(balls);
+    check(!balls.isAsleep(balls.indexOf(left)), "erase: the neighbour of the erased ball wakes");
+    check(balls.isAsleep(balls.indexOf(far)), "erase: a distant sleeper stays asleep");
+    check(balls.getSleepingCount() == 1, "erase: one ball left asleep");
+}
+
+// Steps as headless does without walls
+template <typename T>
+static void run(ParticleStore<T>& balls, Spawner& spawner, uint64_t& step, uint64_t count)
+{
+    for (const uint64_t end = step + count; step < end; ++step) {
+        spawner.update(balls, step, static_cast<float>(step) / 60.f);
+        balls.updatePositions();
+        Solver::resolveCollisions<T>(balls);
+    }
+}
+
+template <typename T>
+static bool sameState(const ParticleStore<T>& a, const ParticleStore<T>& b)
+{
+    return a.x == b.x && a.y == b.y && a.vx == b.vx && a.vy == b.vy && a.trial_step == b.trial_step
+        && a.asleep == b.asleep && a.still_steps == b.still_steps && a.getSleepingCount() == b.getSleepingCount();
+}
+
+// Stepping a loaded snapshot gives what stepping on from the save gave, sleepers and step sizes included
+static void testSnapshotResumes()
+{
+    const auto makeSpawner = [] {
+        Spawner spawner(7);
+        spawner.min_radius = 4.f;
+        spawner.max_radius = 8.f;
+        spawner.interval   = 2;
+        spawner.max_balls  = 80;
+        spawner.lifetime   = 900;
+        return spawner;
+    };
+    const std::string path = "tests_snapshot.bin";
+    Solver::setBroadPhase(BroadPhase::Grid);
+
+    ParticleStore<RK45Ball> balls;
+    balls.setSleeping(true);
+    Spawner spawner = makeSpawner();
+    uint64_t step = 0;
+    run(balls, spawner, step, 800);
+    check(balls.getSleepingCount() > 0, "snapshot: some balls asleep when saved");
+    const std::vector<Wall> walls;
+    check(Snapshot::save(path, balls, walls, step, spawner.getState(balls)), "snapshot: saved");
+    run(balls, spawner, step, 150);
+
+    ParticleStore<RK45Ball> loaded;
+    loaded.setSleeping(true);
+    Spawner loaded_spawner = makeSpawner();
+    std::vector<Wall> loaded_walls;
+    uint64_t loaded_step = 0;
+    std::string state;
+    check(Snapshot::load(path, loaded, loaded_walls, loaded_step, state), "snapshot: loaded");
+    loaded_spawner.setState(state, loaded);
+    run(loaded, loaded_spawner, loaded_step, 150);
+    std::remove(path.c_str());
+
+    check(loaded_step == step && sameState(balls, loaded), "snapshot: resumed run matches the uninterrupted one");
+    check(loaded_spawner.getDespawnCount() == spawner.getDespawnCount(), "snapshot: lifetimes carry over");
+}
+
+// Barnes–Hut at the default opening angle stays within 1% of the exact pairwise sum, and an
+// opening angle past BarnesHut::MAX_THETA is clamped
+static void testGravitationMatchesPairwise()
+{
+    ParticleStore<VerletBall> balls;
+    utils::Random randomizer(3);
+    for (int i{0}; i < 3000; ++i) {
+        const Scalar radius = randomScalar(randomizer, 1.f, 4.f);
+        balls.emplace_back(radius, {randomScalar(randomizer, 0.f, 1000.f), randomScalar(randomizer, 0.f, 1000.f)}, 0.f, 0.f);
+    }
+    const Gravitation settings = Forces::getGravitation();
+    Gravitation gravitation;
+    gravitation.enabled = true;
+    gravitation.theta   = 0.5f;
+    Forces::setGravitation(gravitation);
+    Forces::accumulate(balls);
+
+    const Scalar soft2 = gravitation.softening * gravitation.softening;
+    double error = 0.0, magnitude = 0.0;
+    for (size_t i{0}; i < balls.size(); ++i) {
+        Scalar sum_x = 0.f, sum_y = 0.f;
+        for (size_t j{0}; j < balls.size(); ++j) {
+            if (j == i) continue;
+            const Scalar dx = balls.x[j] - balls.x[i], dy = balls.y[j] - balls.y[i];
+            const Scalar d2 = dx * dx + dy * dy + soft2;
+            const Scalar strength = balls.radius[j] * balls.radius[j] / (d2 * utils::sqrt(d2));
+            sum_x += strength * dx;
+            sum_y += strength * dy;
+        }
+        const double exact_x = static_cast<double>(gravitation.constant * sum_x);
+        const double exact_y = static_cast<double>(gravitation.constant * sum_y);
+        error     += std::hypot(static_cast<double>(balls.ax[i]) - exact_x, static_cast<double>(balls.ay[i]) - exact_y);
+        magnitude += std::hypot(exact_x, exact_y);
+    }
+    check(error < 0.01 * magnitude, "gravitation: theta 0.5 within 1% of the pairwise sum");
+
+    gravitation.theta = 5.f;
+    Forces::setGravitation(gravitation);
+    check(Forces::getGravitation().theta == Scalar(BarnesHut::MAX_THETA), "gravitation: theta clamped");
+    Forces::setGravitation(settings);
+}
+
+// Balls scattered up front, the same for every seed
+static ParticleStore<VerletBall> scatter(uint32_t count)
+{
+    ParticleStore<VerletBall> balls;
+    utils::Random randomizer(11);
+    for (uint32_t i{0}; i < count; ++i) {
+        const Scalar radius = randomScalar(randomizer, 2.f, 5.f);
+        balls.emplace_back(radius, {randomScalar(randomizer, 5.f, 995.f), randomScalar(randomizer, 5.f, 995.f)}, 0.f, 0.f);
+    }
+    return balls;
+}
+
+static ParticleStore<VerletBall> stepSerial(uint32_t steps)
+{
+    ParticleStore<VerletBall> balls = scatter(3000);
+    for (uint32_t step{0}; step < steps; ++step) {
+        Forces::accumulate(balls);
+        balls.updatePositions();
+        Solver::resolveCollisions(balls);
+    }
+    return balls;
+}
+
+static ParticleStore<VerletBall> stepGraph(uint32_t steps, size_t threads)
+{
+    ParticleStore<VerletBall> balls = scatter(3000);
+    JobSystem jobs(threads);
+    const std::vector<Wall> walls;
+    StepGraph<VerletBall, std::vector<Wall>> graph(balls, walls);
+    graph.setBallsPerTask(256);
+    for (uint32_t step{0}; step < steps; ++step) graph.step(jobs);
+    return balls;
+}
+
+// The step graph gives the serial results whatever its thread count: Gauss-Seidel strips do not depend
+// on it, colored and Jacobi contacts (solved through the thread pool forked onto the jobs) match
+// Solver::resolveCollisions exactly
+static void testStepGraphMatchesSerial()
+{
+    Solver::setBroadPhase(BroadPhase::Grid);
+    const ContactSolver previous = Solver::getContactSolver();
+    for (const ContactSolver mode : {ContactSolver::Colored, ContactSolver::Jacobi}) {
+        Solver::setContactSolver(mode);
+        const ParticleStore<VerletBall> serial = stepSerial(60);
+        for (const size_t threads : {size_t{1}, size_t{4}}) {
+            const ParticleStore<VerletBall> graph = stepGraph(60, threads);
+            check(graph.x == serial.x && graph.y == serial.y,
+                  threads == 1 ? "step graph: 1 thread matches serial contacts" : "step graph: 4 threads match serial contacts");
+        }
+    }
+    Solver::setContactSolver(ContactSolver::GaussSeidel);
+    const ParticleStore<VerletBall> one = stepGraph(60, 1), four = stepGraph(60, 4);
+    check(one.x == four.x && one.y == four.y, "step graph: strips give the same result on 1 and 4 threads");
+    Solver::setContactSolver(previous);
+}
+
+// ThreadPool::parallelFor inside a task, and inside one of its own items, is forked onto the job
+// system and every item runs once
+static void testNestedParallelFor()
+{
+    JobSystem jobs(4);
+    ThreadPool pool(4);
+    std::atomic<uint32_t> items{0}, inner{0};
+    TaskGraph graph;
+    graph.add("outer", [] { return size_t{8};}, [&](size_t) {
+        pool.parallelFor(16, [&](size_t) {
+            items.fetch_add(1, std::memory_order_relaxed);
+            pool.parallelFor(4, [&](size_t) { inner.fetch_add(1, std::memory_order_relaxed);});
+        });
+    });
+    for (int run{0}; run < 10; ++run) jobs.run(graph);
+    check(items == 10 * 8 * 16 && inner == 10 * 8 * 16 * 4, "jobs: nested parallelFor completes");
+    check(parallel_for_delegate.parallel_for == nullptr, "jobs: the pool is its own again after a run");
+}
+
+// Fixed: exact arithmetic where it can be, saturation instead of wrapping, and the functions within
+// float precision as utils/fixed.h claims. Checked whatever Scalar the build uses.
+static void testFixed()
+{
+    using utils::Fixed;
+    const Fixed max = Fixed::fromRaw(INT64_MAX), min = Fixed::fromRaw(-INT64_MAX);
+    check(Fixed(3) * Fixed(0.5) == Fixed(1.5) && Fixed(1) / Fixed(4) == Fixed(0.25) && Fixed(-7) / Fixed(2) == Fixed(-3.5),
+          "fixed: exact products and quotients");
+    check(Fixed::fromRaw(1) * Fixed(0.5) == Fixed::fromRaw(1) && Fixed::fromRaw(1) * Fixed(0.25) == Fixed(0),
+          "fixed: products round to nearest");
+    check(Fixed(100000) * Fixed(100000) == max && Fixed(-100000) * Fixed(100000) == min, "fixed: products saturate");
+    check(Fixed(1000000000) / Fixed(0.001) == max && Fixed(-1000000000) / Fixed(0.001) == min,
+          "fixed: quotients saturate");
+    check(Fixed(1) / Fixed(0) == max && Fixed(-1) / Fixed(0) == min, "fixed: division by zero saturates");
+
+    check(floor(Fixed(2.75)) == Fixed(2) && floor(Fixed(-1.5)) == Fixed(-2) && floor(Fixed(-2)) == Fixed(-2)
+          && floor(Fixed::fromRaw(-1)) == Fixed(-1), "fixed: floor rounds negatives down");
+
+    check(sqrt(Fixed(4)) == Fixed(2) && sqrt(Fixed(0.25)) == Fixed(0.5) && sqrt(Fixed(1000000)) == Fixed(1000)
+          && sqrt(Fixed::fromRaw(1)) == Fixed::fromRaw(1 << 16) && sqrt(Fixed(-1)) == Fixed(0),
+          "fixed: sqrt scales small and large values");
+
+    double sine = 0.0, cosine = 0.0, power = 0.0, logarithm = 0.0, root = 0.0, pow_error = 0.0;
+    for (double a{-20.0}; a <= 20.0; a += 0.01) {
+        sine   = std::max(sine, std::abs(static_cast<double>(sin(Fixed(a))) - std::sin(a)));
+        cosine = std::max(cosine, std::abs(static_cast<double>(cos(Fixed(a))) - std::cos(a)));
+        if (a >= -8.0) power = std::max(power, std::abs(static_cast<double>(exp2(Fixed(a))) / std::exp2(a) - 1.0));
+    }
+    for (double v{0.01}; v < 1e6; v *= 1.05) {
+        logarithm = std::max(logarithm, std::abs(static_cast<double>(log2(Fixed(v))) - std::log2(v)));
+        root      = std::max(root, std::abs(static_cast<double>(sqrt(Fixed(v))) / std::sqrt(v) - 1.0));
+        pow_error = std::max(pow_error, std::abs(static_cast<double>(pow(Fixed(v), Fixed(0.2))) / std::pow(v, 0.2) - 1.0));
+    }
+    check(sine < 1e-8 && cosine < 1e-8, "fixed: sin and cos within 1e-8");
+    check(power < 1e-7 && logarithm < 1e-7, "fixed: exp2 and log2 within float precision");
+    check(root < 1e-7 && pow_error < 1e-7, "fixed: sqrt and pow within float precision");
+    check(exp2(Fixed(40)) == max && exp2(Fixed(-40)) == Fixed(0), "fixed: exp2 saturates");
+}
+
+// Two balls on the same spot part along x instead of turning NaN (float) or saturating (Fixed)
+template <typename T>
+static bool partsCoincident()
+{
+    ParticleStore<T> balls;
+    balls.emplace_back(5.f, {500.f, 500.f}, 0.f, 0.f);
+    balls.emplace_back(5.f, {500.f, 500.f}, 0.f, 0.f);
+    Solver::setBroadPhase(BroadPhase::Grid);
+    Solver::resolveCollisions<T>(balls);
+    const Scalar gap = balls.x[1] - balls.x[0];
+    return gap > Scalar(9.f) && gap < Scalar(11.f) && balls.y[0] == Scalar(500.f) && balls.y[1] == Scalar(500.f);
+}
+
+static void testCoincidentCentres()
+{
+    check(partsCoincident<EulerBall>() && partsCoincident<ImplicitEulerBall>(), "collide: coincident Euler balls part");
+    check(partsCoincident<RK4Ball>() && partsCoincident<RK45Ball>(), "collide: coincident RK4 balls part");
+}
+
+int main()
+{
+    testFixed();
+    testEraseWakesNeighboursOnly();
+    testSnapshotResumes();
+    testGravitationMatchesPairwise();
+    testCoincidentCentres();
+    testStepGraphMatchesSerial();
+    testNestedParallelFor();
+
+    if (failures > 0) std::printf("%d check(s) failed\n", failures);
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Heap allocation counter for debug builds
+// Replaces the global operator new, so include this header from exactly one translation unit
+// (main.cpp). With NDEBUG nothing is replaced and the count stays at 0.
+// Every thread counts its own allocations, so the window thread can check its frames while the
+// simulation thread and the job workers allocate on their own schedule.
+// The aligned forms (alignas above the default, e.g. the JobSystem workers) are counted as well.
+
+namespace utils{
+
+inline thread_local uint64_t allocation_count = 0;
+
+// Allocations made by the calling thread so far
+[[nodiscard]] inline uint64_t getAllocationCount() {
+    return allocation_count;
+}
+
+}
+
+#ifndef NDEBUG
+void* operator new(std::size_t size) {
+    ++utils::allocation_count;
+    if (void* memory = std::malloc(size > 0 ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory);}
+void operator delete[](void* memory) noexcept { std::free(memory);}
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory);}
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory);}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++utils::allocation_count;
+    const std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    if (void* memory = _aligned_malloc(size > 0 ? size : 1, align)) return memory;
+#else
+    // aligned_alloc wants a multiple of the alignment
+    const std::size_t rounded = ((size > 0 ? size : 1) + align - 1) / align * align;
+    if (void* memory = std::aligned_alloc(align, rounded)) return memory;
+#endif
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+#ifdef _WIN32
+void operator delete(void* memory, std::align_val_t) noexcept { _aligned_free(memory);}
+#else
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory);}
+#endif
+void operator delete[](void* memory, std::align_val_t alignment) noexcept { operator delete(memory, alignment);}
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept { operator delete(memory, alignment);}
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept { operator delete(memory, alignment);}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+#endif
+
+namespace utils{
+
+// Instruction sets available at runtime, detected once
+struct CpuFeatures {
+    bool sse2 = false;
+    bool avx2 = false;
+};
+
+inline CpuFeatures detectCpuFeatures() {
+    CpuFeatures features;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    features.sse2 = (info[3] & (1 << 26)) != 0;
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+    if (max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = os_saves_ymm && (info[1] & (1 << 5)) != 0;
+    }
+#endif
+    return features;
+}
+
+inline const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace utils {
+
+// Signed Q32.32 fixed-point number: 32 integer bits (up to ±2.1e9) and 32 fraction bits (2.3e-10).
+// Every operation is integer arithmetic with the same rounding on every compiler and CPU, so a
+// simulation in Fixed gives the same bits everywhere, which float and double do not promise once
+// compilers reorder, contract or call their own libm. Products and quotients go through 128-bit
+// intermediates and saturate instead of wrapping. sqrt, sin, cos and pow below are exact to a few
+// units in the last place of float.
+// The promise holds only as far as the inputs are the same bits: values converted from float must
+// come out of correctly rounded parsing or exact constants, and random values must be built from
+// raw engine bits (randomScalar in spawner.h), never from the <random> distributions or from float
+// math done before the conversion, which may differ between platforms.
+class Fixed {
+private:
+    static constexpr int FRACTION_BITS = 32;
+    static constexpr int64_t ONE       = int64_t{1} << FRACTION_BITS;
+    static constexpr int64_t MAX_RAW   = INT64_MAX;
+    static constexpr int64_t MIN_RAW   = -INT64_MAX;
+
+    int64_t raw = 0;
+
+    // (a * b) >> 32, rounded to nearest
+    static int64_t multiply(int64_t a, int64_t b)
+    {
+#if defined(__SIZEOF_INT128__)
+        const __int128 product = static_cast<__int128>(a) * b + (__int128{1} << (FRACTION_BITS - 1));
+        const __int128 shifted = product >> FRACTION_BITS;
+        if (shifted > MAX_RAW) return MAX_RAW;
+        if (shifted < MIN_RAW) return MIN_RAW;
+        return static_cast<int64_t>(shifted);
+#else
+        int64_t high;
+        uint64_t low = static_cast<uint64_t>(_mul128(a, b, &high));
+        const uint64_t rounded = low + (uint64_t{1} << (FRACTION_BITS - 1));
+        if (rounded < low) ++high;
+        // The result must fit in the bits [32, 96) of the product
+        if (high >= (int64_t{1} << (FRACTION_BITS - 1))) return MAX_RAW;
+        if (high < -(int64_t{1} << (FRACTION_BITS - 1))) return MIN_RAW;
+        return static_cast<int64_t>(__shiftright128(rounded, static_cast<uint64_t>(high), FRACTION_BITS));
+#endif
+    }
+
+    // (a << 32) / b, truncated towards zero
+    static int64_t divide(int64_t a, int64_t b)
+    {
+        if (b == 0) return a >= 0 ? MAX_RAW : MIN_RAW;
+        const uint64_t magnitude_a = a < 0 ? 0 - static_cast<uint64_t>(a) : static_cast<uint64_t>(a);
+        const uint64_t magnitude_b = b < 0 ? 0 - static_cast<uint64_t>(b) : static_cast<uint64_t>(b);
+        const bool negative = (a < 0) != (b < 0);
+        if ((magnitude_a >> (63 - FRACTION_BITS)) >= magnitude_b) return negative ? MIN_RAW : MAX_RAW;
+#if defined(__SIZEOF_INT128__)
+        const unsigned __int128 quotient = (static_cast<unsigned __int128>(magnitude_a) << FRACTION_BITS) / magnitude_b;
+        const int64_t result = static_cast<int64_t>(quotient);
+#else
+        uint64_t remainder;
+        const int64_t result = static_cast<int64_t>(_udiv128(magnitude_a >> (64 - FRACTION_BITS), magnitude_a << FRACTION_BITS,
+                                                             magnitude_b, &remainder));
+#endif
+        return negative ? -result : result;
+    }
+
+    // floor(sqrt(n)), digit by digit
+    static uint64_t squareRoot(uint64_t n)
+    {
+        uint64_t result = 0;
+        uint64_t bit = uint64_t{1} << 62;
+        while (bit > n) bit >>= 2;
+        while (bit != 0) {
+            if (n >= result + bit) {
+                n -= result + bit;
+                result = (result >> 1) + bit;
+            } else {
+                result >>= 1;
+            }
+            bit >>= 2;
+        }
+        return result;
+    }
+
+public:
+    constexpr Fixed() = default;
+
+    template <typename Integer, std::enable_if_t<std::is_integral_v<Integer>, int> = 0>
+    constexpr Fixed(Integer value) : raw(static_cast<int64_t>(value) * ONE) {}
+
+    // Rounded to nearest, so constants written as float or double literals convert the same everywhere
+    template <typename Float, std::enable_if_t<std::is_floating_point_v<Float>, int> = 0>
+    constexpr Fixed(Float value)
+        : raw(static_cast<int64_t>(static_cast<double>(value) * static_cast<double>(ONE) + (value < 0 ? -0.5 : 0.5)))
+    {}
+
+    [[nodiscard]] static constexpr Fixed fromRaw(int64_t value)
+    {
+        Fixed result;
+        result.raw = value;
+        return result;
+    }
+    [[nodiscard]] constexpr int64_t getRaw() const { return raw;}
+
+    explicit constexpr operator float() const { return static_cast<float>(static_cast<double>(raw) / ONE);}
+    explicit constexpr operator double() const { return static_cast<double>(raw) / ONE;}
+
+    constexpr Fixed operator-() const { return fromRaw(-raw);}
+    constexpr Fixed operator+() const { return *this;}
+
+    Fixed& operator+=(Fixed other) { raw += other.raw; return *this;}
+    Fixed& operator-=(Fixed other) { raw -= other.raw; return *this;}
+    Fixed& operator*=(Fixed other) { raw = multiply(raw, other.raw); return *this;}
+    Fixed& operator/=(Fixed other) { raw = divide(raw, other.raw); return *this;}
+
+    friend Fixed operator+(Fixed a, Fixed b) { return a += b;}
+    friend Fixed operator-(Fixed a, Fixed b) { return a -= b;}
+    friend Fixed operator*(Fixed a, Fixed b) { return a *= b;}
+    friend Fixed operator/(Fixed a, Fixed b) { return a /= b;}
+
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw;}
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw;}
+    friend constexpr bool operator<(Fixed a, Fixed b)  { return a.raw < b.raw;}
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw;}
+    friend constexpr bool operator>(Fixed a, Fixed b)  { return a.raw > b.raw;}
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw;}
+
+    friend Fixed abs(Fixed value) { return value.raw < 0 ? -value : value;}
+
+    // Largest integer not above value
+    friend Fixed floor(Fixed value) { return fromRaw(value.raw & ~(ONE - 1));}
+
+    // 0 for negative values
+    friend Fixed sqrt(Fixed value)
+    {
+        if (value.raw <= 0) return {};
+        // Shift the value up to use all 64 bits, an even shift keeps the root exact
+        uint64_t n = static_cast<uint64_t>(value.raw);
+        int shift = 0;
+        while (n < (uint64_t{1} << 62)) {
+            n <<= 2;
+            shift += 2;
+        }
+        // sqrt(raw * 2^32) = sqrt(n) * 2^(16 - shift / 2)
+        const uint64_t root = squareRoot(n);
+        const int scale = FRACTION_BITS / 2 - shift / 2;
+        return fromRaw(static_cast<int64_t>(scale >= 0 ? root << scale : root >> -scale));
+    }
+
+    friend Fixed sin(Fixed angle)
+    {
+        // Reduce to [-pi/2, pi/2] where the series converges quickly
+        const Fixed pi = Fixed(3.14159265358979323846);
+        const Fixed two_pi = pi + pi, half_pi = Fixed(1.57079632679489661923);
+        Fixed x = angle - two_pi * floor(angle / two_pi + Fixed(0.5));
+        if (x > half_pi) x = pi - x;
+        if (x < -half_pi) x = -pi - x;
+
+        // x - x^3/3! + x^5/5! - ... up to x^13
+        const Fixed x2 = x * x;
+        Fixed term = x, sum = x;
+        for (int n{2}; n <= 12; n += 2) {
+            term = -term * x2 / Fixed(n * (n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    friend Fixed cos(Fixed angle) { return sin(angle + Fixed(1.57079632679489661923));}
+
+    // Base 2 logarithm of a positive value, one fraction bit per squaring
+    friend Fixed log2(Fixed value)
+    {
+        if (value.raw <= 0) return fromRaw(MIN_RAW);
+        int64_t integer = 0;
+        uint64_t mantissa = static_cast<uint64_t>(value.raw);
+        while (mantissa >= static_cast<uint64_t>(2 * ONE)) {
+            mantissa >>= 1;
+            ++integer;
+        }
+        while (mantissa < static_cast<uint64_t>(ONE)) {
+            mantissa <<= 1;
+            --integer;
+        }
+        int64_t fraction = 0;
+        Fixed y = fromRaw(static_cast<int64_t>(mantissa));
+        for (int bit{FRACTION_BITS - 1}; bit >= 0; --bit) {
+            y *= y;
+            if (y.raw >= 2 * ONE) {
+                y.raw >>= 1;
+                fraction |= int64_t{1} << bit;
+            }
+        }
+        return fromRaw(integer * ONE + fraction);
+    }
+
+    // 2 to the power of value, saturating
+    friend Fixed exp2(Fixed value)
+    {
+        const Fixed whole = floor(value);
+        const int64_t integer = whole.raw >> FRACTION_BITS;
+        if (integer >= 31) return fromRaw(MAX_RAW);
+        if (integer < -FRACTION_BITS) return {};
+
+        // 2^f = e^(f ln 2) for the fraction f in [0, 1)
+        const Fixed x = (value - whole) * Fixed(0.69314718055994530942);
+        Fixed term = 1, sum = 1;
+        for (int n{1}; n <= 12; ++n) {
+            term = term * x / Fixed(n);
+            sum += term;
+        }
+        return fromRaw(integer >= 0 ? sum.raw << integer : sum.raw >> -integer);
+    }
+
+    friend Fixed pow(Fixed base, Fixed exponent)
+    {
+        if (base.raw <= 0) return {};
+        return exp2(exponent * log2(base));
+    }
+};
+
+// Visible to qualified calls (utils::sqrt) as well as to argument-dependent lookup
+Fixed abs(Fixed value);
+Fixed floor(Fixed value);
+Fixed sqrt(Fixed value);
+Fixed sin(Fixed angle);
+Fixed cos(Fixed angle);
+Fixed log2(Fixed value);
+Fixed exp2(Fixed value);
+Fixed pow(Fixed base, Fixed exponent);
+
+}
@@ -1,33 +1,59 @@
 #pragma once
 
 #include<cmath>
+#include<type_traits>
+
+namespace utils{
+
+// Square root, sine, cosine and power of float and double. utils::Fixed brings its own
+// deterministic versions (utils/fixed.h), so physics code written with these works for any Scalar.
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+T sqrt(T value) { return std::sqrt(value);}
+
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+T abs(T value) { return std::abs(value);}
+
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+T sin(T value) { return std::sin(value);}
+
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+T cos(T value) { return std::cos(value);}
+
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+T pow(T base, T exponent) { return std::pow(base, exponent);}
+
+}
 
 #ifdef HAVE_SFML
 #include <SFML/Graphics.hpp>
 
 namespace utils{
 
-float norm2f(const sf::Vector2f& vector){
-    return std::sqrt(vector.x * vector.x + vector.y * vector.y);
+template <typename T>
+T norm2f(const sf::Vector2<T>& vector){
+    return sqrt(vector.x * vector.x + vector.y * vector.y);
 }
 
-sf::Vector2f normalize(const sf::Vector2f& vector) {
-    float magnitude = norm2f(vector);
-    return (magnitude > 0) ? vector / magnitude : sf::Vector2f(0.f, 0.f);
+template <typename T>
+sf::Vector2<T> normalize(const sf::Vector2<T>& vector) {
+    T magnitude = norm2f(vector);
+    return (magnitude > T(0)) ? vector / magnitude : sf::Vector2<T>(T(0), T(0));
 }
 
-float dot(const sf::Vector2f& vector1, const sf::Vector2f& vector2){
+template <typename T>
+T dot(const sf::Vector2<T>& vector1, const sf::Vector2<T>& vector2){
     return vector1.x * vector2.x + vector1.y * vector2.y;
 }
 
-sf::Vector2f proj(const sf::Vector2f& A, const sf::Vector2f& B) {
-    sf::Vector2f result;
-    float dotProduct = dot(A, B);
-    float magnitudeSquaredB = dot(B, B);
-    if (magnitudeSquaredB != 0) {
+template <typename T>
+sf::Vector2<T> proj(const sf::Vector2<T>& A, const sf::Vector2<T>& B) {
+    sf::Vector2<T> result;
+    T dotProduct = dot(A, B);
+    T magnitudeSquaredB = dot(B, B);
+    if (magnitudeSquaredB != T(0)) {
         result = (dotProduct / magnitudeSquaredB) * B;
     } else {
-        result = sf::Vector2f(0.f, 0.f); // Handle the case where B is a zero vector
+        result = sf::Vector2<T>(T(0), T(0)); // Handle the case where B is a zero vector
     }
     return result;
 }
@@ -36,4 +62,3 @@ sf::Vector2f proj(const sf::Vector2f& A, const sf::Vector2f& B) {
 
 
 #endif
-
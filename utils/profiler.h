@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils{
+
+// Per-phase frame profiler
+// PROFILE_SCOPE("name") adds the time spent in the enclosing block to that phase.
+// endFrame() closes the frame and keeps a smoothed per-phase time for the overlay.
+// While tracing, every scope is also recorded as a Chrome trace event (chrome://tracing, Perfetto).
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t MAX_PHASES = 32;
+
+    struct Phase {
+        const char* name = nullptr;
+        std::atomic<int64_t> frame_ns{0};   // accumulated during the current frame
+        double last_ms     = 0.0;           // last closed frame
+        double smoothed_ms = 0.0;           // exponential moving average
+        double total_ms    = 0.0;           // every closed frame
+    };
+
+    class Scope {
+    private:
+        Profiler& profiler;
+        size_t phase;
+        Clock::time_point start;
+    public:
+        Scope(Profiler& profiler, size_t phase) : profiler(profiler), phase(phase), start(Clock::now()) {}
+        ~Scope() { profiler.record(phase, start, Clock::now()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+private:
+    struct TraceEvent {
+        size_t phase;
+        int64_t start_us;
+        int64_t duration_us;
+        size_t thread;
+    };
+
+    std::array<Phase, MAX_PHASES> phases;
+    std::atomic<size_t> phase_count{0};
+    uint64_t frame_count = 0;
+    std::mutex mutex;
+
+    std::atomic<bool> tracing{false};
+    std::vector<TraceEvent> events;
+    const Clock::time_point epoch = Clock::now();
+
+    Profiler() = default;
+
+public:
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // Index of a phase, registered on first use. name must outlive the profiler (string literal).
+    size_t phaseIndex(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const size_t count = phase_count.load();
+        for (size_t i{0}; i < count; ++i) {
+            if (std::strcmp(phases[i].name, name) == 0) return i;
+        }
+        if (count == MAX_PHASES) return MAX_PHASES - 1;
+        phases[count].name = name;
+        phase_count.store(count + 1);
+        return count;
+    }
+
+    void record(size_t phase, Clock::time_point start, Clock::time_point end) {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        phases[phase].frame_ns.fetch_add(ns, std::memory_order_relaxed);
+
+        if (tracing.load(std::memory_order_relaxed)) {
+            const int64_t start_us = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch).count();
+            const size_t thread    = std::hash<std::thread::id>{}(std::this_thread::get_id());
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back({phase, start_us, ns / 1000, thread});
+        }
+    }
+
+    // Close the current frame
+    void endFrame() {
+        const size_t count = phase_count.load();
+        for (size_t i{0}; i < count; ++i) {
+            Phase& phase = phases[i];
+            phase.last_ms     = phase.frame_ns.exchange(0) * 1e-6;
+            phase.smoothed_ms = 0.9 * phase.smoothed_ms + 0.1 * phase.last_ms;
+            phase.total_ms   += phase.last_ms;
+        }
+        ++frame_count;
+    }
+
+    [[nodiscard]] uint64_t getFrameCount() const { return frame_count;}
+    [[nodiscard]] size_t getPhaseCount() const { return phase_count.load();}
+    [[nodiscard]] const Phase& getPhase(size_t i) const { return phases[i];}
+
+    // One "name  time" line per phase into buffer, returns the number of characters written
+    size_t format(char* buffer, size_t size) const {
+        size_t written = 0;
+        for (size_t i{0}; i < getPhaseCount() && written < size; ++i) {
+            const int n = std::snprintf(buffer + written, size - written, "%-18s %6.2f ms\n",
+                                        phases[i].name, phases[i].smoothed_ms);
+            if (n < 0) break;
+            written += static_cast<size_t>(n);
+        }
+        return std::min(written, size);
+    }
+
+    void startTrace() {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+        tracing = true;
+    }
+
+    [[nodiscard]] bool isTracing() const { return tracing.load();}
+
+    // Stop recording and write the events as Chrome trace-event JSON
+    bool stopTrace(const std::string& path) {
+        tracing = false;
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) return false;
+
+        std::fprintf(file, "{\"traceEvents\":[\n");
+        for (size_t i{0}; i < events.size(); ++i) {
+            const TraceEvent& event = events[i];
+            std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":0,\"tid\":%zu}%s\n",
+                         phases[event.phase].name, static_cast<long long>(event.start_us),
+                         static_cast<long long>(event.duration_us), event.thread % 100000,
+                         i + 1 < events.size() ? "," : "");
+        }
+        std::fprintf(file, "]}\n");
+        std::fclose(file);
+        events.clear();
+        return true;
+    }
+};
+
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Time the rest of the enclosing block under the given phase name
+#define PROFILE_SCOPE(name)                                                                             \
+    static const size_t PROFILE_CONCAT(profile_phase_, __LINE__) = utils::Profiler::instance().phaseIndex(name); \
+    utils::Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(utils::Profiler::instance(),       \
+                                                                     PROFILE_CONCAT(profile_phase_, __LINE__))
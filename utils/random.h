@@ -9,6 +9,7 @@
 #include <ctime>
 #include <atomic>
 #include <cassert>
+#include <sstream>
 
 
 // automatically defined by the compiler when compile code on a Windows platform.
@@ -26,8 +27,9 @@ namespace utils{
 
 class Random {
 private:
-    // using std::default_random_engine = std::mt19937
-    std::default_random_engine generator;
+    // mt19937 rather than std::default_random_engine, which is a different engine in every
+    // standard library: its raw output is the same sequence everywhere
+    std::mt19937 generator;
 
     // Static atomic variable for sequential seeding
     static std::atomic<unsigned int> sequentialSeed;
@@ -138,6 +140,24 @@ public:
         return sequentialSeed.load();
     }
 
+    // Engine state as text, setState restores the exact same sequence (snapshots, replays)
+    std::string getState() const {
+        std::ostringstream out;
+        out << generator;
+        return out.str();
+    }
+
+    void setState(const std::string& state) {
+        std::istringstream in(state);
+        in >> generator;
+    }
+
+    // Next raw 32 bits of the engine. Unlike the distributions below, which every standard library
+    // implements its own way, these are the same on every platform.
+    uint32_t nextBits() {
+        return static_cast<uint32_t>(generator());
+    }
+
     // Functions for code-readability
     bool getRandomBool(){
         return uniformRNG(0, 1);